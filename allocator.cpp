@@ -0,0 +1,128 @@
+/* Huge-page and NUMA-aware allocation for the large arrays of the labelers.
+ Large arrays are mapped directly with mmap, so that the page size and the
+ NUMA policy can be set before any page is touched. The NUMA policy is set
+ with the raw mbind system call, so libnuma is not needed. */
+
+#include "allocator.h"
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+#ifndef MPOL_F_MEMS_ALLOWED
+#define MPOL_F_MEMS_ALLOWED (1 << 2)
+#endif
+
+static hk_alloc_policy current_policy = {SMALL_PAGES, NUMA_DEFAULT};
+
+/* Arrays below this size come from the heap. */
+static const size_t map_threshold = 1 << 21;
+static const size_t huge_page = 1 << 21;
+
+void hk_set_alloc_policy(const hk_alloc_policy& policy) {
+  current_policy = policy;
+}
+
+hk_alloc_policy hk_get_alloc_policy() {
+  return current_policy;
+}
+
+/* The number of bytes actually mapped for an array of 'bytes' bytes. */
+
+static size_t mapped_bytes(size_t bytes) {
+  return (bytes + huge_page - 1) / huge_page * huge_page;
+}
+
+/* Interleave the pages of [p, p+bytes) over the nodes this process may use. */
+
+static void interleave(void* p, size_t bytes) {
+  unsigned long nodes[16];
+  int mode;
+  memset(nodes, 0, sizeof(nodes));
+  const unsigned long max_node = sizeof(nodes) * 8;
+  if (syscall(SYS_get_mempolicy, &mode, nodes, max_node, 0,
+              MPOL_F_MEMS_ALLOWED) != 0)
+    return;
+  syscall(SYS_mbind, p, bytes, MPOL_INTERLEAVE, nodes, max_node, 0);
+}
+
+/* Touch one byte in every small page, splitting the array like a static
+ * OpenMP schedule over its elements would.
+ */
+static void first_touch(char* p, size_t bytes) {
+  const size_t page = 4096;
+  #pragma omp parallel
+  {
+#ifdef _OPENMP
+    const size_t n_threads = omp_get_num_threads();
+    const size_t thread = omp_get_thread_num();
+#else
+    const size_t n_threads = 1, thread = 0;
+#endif
+    const size_t lo = bytes * thread / n_threads;
+    const size_t hi = bytes * (thread + 1) / n_threads;
+    for (size_t i = lo; i < hi; i += page)
+      p[i] = 0;
+  }
+}
+
+/* Map a large array of 'bytes' bytes with the current policy. The pages are
+ * zero when first touched.
+ */
+static void* map_array(size_t bytes) {
+  const size_t length = mapped_bytes(bytes);
+  void* p = MAP_FAILED;
+  if (current_policy.pages == EXPLICIT_HUGE_PAGES)
+    p = mmap(0, length, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (p == MAP_FAILED)
+    p = mmap(0, length, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    throw std::bad_alloc();
+
+  if (current_policy.pages != SMALL_PAGES)
+    madvise(p, length, MADV_HUGEPAGE);
+  if (current_policy.numa == NUMA_INTERLEAVE)
+    interleave(p, length);
+  else if (current_policy.numa == NUMA_FIRST_TOUCH)
+    first_touch((char*)p, bytes);
+  return p;
+}
+
+int* hk_alloc_ints(size_t n) {
+  if (n * sizeof(int) < map_threshold)
+    return new int[n]();
+  return (int*)map_array(n * sizeof(int));
+}
+
+void hk_free_ints(int* p, size_t n) {
+  if (!p)
+    return;
+  if (n * sizeof(int) < map_threshold)
+    delete[] p;
+  else
+    munmap(p, mapped_bytes(n * sizeof(int)));
+}
+
+double* hk_alloc_doubles(size_t n) {
+  if (n * sizeof(double) < map_threshold)
+    return new double[n];
+  return (double*)map_array(n * sizeof(double));
+}
+
+void hk_free_doubles(double* p, size_t n) {
+  if (!p)
+    return;
+  if (n * sizeof(double) < map_threshold)
+    delete[] p;
+  else
+    munmap(p, mapped_bytes(n * sizeof(double)));
+}
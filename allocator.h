@@ -0,0 +1,52 @@
+#ifndef ALLOCATOR_H_
+#define ALLOCATOR_H_
+
+#include <cstddef>
+
+/* Placement of the large arrays of the labelers (the union-find forest, the
+ * relabelling map, cluster sizes and moments, scratch labels). Callers may use
+ * the same allocator for their own label and occupancy arrays.
+ *
+ * -pages: SMALL_PAGES uses the default pages, TRANSPARENT_HUGE_PAGES asks the
+ *  kernel to back the array with huge pages where it can, and
+ *  EXPLICIT_HUGE_PAGES takes them from the reserved hugetlbfs pool (falling
+ *  back to transparent huge pages if the pool is too small).
+ * -numa: NUMA_DEFAULT leaves placement to the kernel (first touch by whoever
+ *  touches a page first), NUMA_INTERLEAVE spreads the pages round-robin over
+ *  all allowed nodes, and NUMA_FIRST_TOUCH touches the array in parallel with
+ *  the static OpenMP schedule used by the parallel loops of the labelers, so
+ *  every page lands on the node of the thread that will use it.
+ */
+enum hk_page_policy { SMALL_PAGES, TRANSPARENT_HUGE_PAGES, EXPLICIT_HUGE_PAGES };
+enum hk_numa_policy { NUMA_DEFAULT, NUMA_INTERLEAVE, NUMA_FIRST_TOUCH };
+
+struct hk_alloc_policy {
+  hk_page_policy pages;
+  hk_numa_policy numa;
+};
+
+/* Set the policy of all later allocations. The default is
+ * {SMALL_PAGES, NUMA_DEFAULT}.
+ */
+void hk_set_alloc_policy(const hk_alloc_policy& policy);
+
+hk_alloc_policy hk_get_alloc_policy();
+
+/* Allocate n ints, initialized to zero. Small arrays come from the heap and
+ * ignore the policy. Throws std::bad_alloc if the memory cannot be mapped,
+ * like new.
+ */
+int* hk_alloc_ints(size_t n);
+
+/* Free an array from hk_alloc_ints. n must be the length it was allocated with. */
+void hk_free_ints(int* p, size_t n);
+
+/* Allocate n doubles with the same policy, for arrays the caller fills
+ * itself. They are not initialized: small arrays come from new double[n] and
+ * large ones are mapped and left untouched, apart from NUMA_FIRST_TOUCH.
+ */
+double* hk_alloc_doubles(size_t n);
+
+void hk_free_doubles(double* p, size_t n);
+
+#endif /* ALLOCATOR_H_ */
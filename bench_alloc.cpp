@@ -0,0 +1,98 @@
+/* Benchmark of the page size and NUMA policies of allocator.h on arrays the
+ * size of those of a large labelling.
+ *
+ * For every policy it times
+ * -touch: allocating two N int arrays and writing them in parallel,
+ * -gather: a parallel pass of random reads, b[i] = a[h(i)], like the final
+ *          gather of uf_canonicalise,
+ * -label: extended_hk_lattice_runs on a square lattice of about N sites at
+ *         p = 0.5927, whose internal arrays use the same policy.
+ * The effect of the policies shows on multi-socket machines with N >= 10^9
+ * (two arrays of 4 GB each). Explicit huge pages need a reserved pool, e.g.
+ *   echo 4200 > /proc/sys/vm/nr_hugepages   (per socket, as root)
+ *
+ * Usage: bench_alloc [N] [p]
+ *  e.g.  g++ -O2 -fopenmp bench_alloc.cpp hk.cpp allocator.cpp -o bench_alloc
+ *        ./bench_alloc 1000000000
+ */
+
+#include "hk.h"
+#include "allocator.h"
+#include "MersenneTwister.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <new>
+
+using namespace std;
+
+typedef chrono::steady_clock wall_clock;
+
+static double seconds_since(wall_clock::time_point start) {
+  return chrono::duration<double>(wall_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  const long long target_N = (argc > 1) ? atoll(argv[1]) : 1000000000LL;
+  const double p = (argc > 2) ? atof(argv[2]) : 0.5927;
+  const int L = (int)sqrt((double)target_N);
+  const int N = L*L;
+  const int dims[2] = {L, L};
+
+  const char* page_names[] = {"small", "transparent", "explicit"};
+  const char* numa_names[] = {"default", "interleave", "first-touch"};
+
+  printf("N = %d\n", N);
+  printf("%-12s %-12s %10s %10s %10s\n", "pages", "numa", "touch (s)",
+         "gather(ns)", "label (s)");
+
+  for (int pages = 0; pages < 3; ++pages)
+    for (int numa = 0; numa < 3; ++numa) {
+      hk_alloc_policy policy = {(hk_page_policy)pages, (hk_numa_policy)numa};
+      hk_set_alloc_policy(policy);
+
+      // Allocate and write two arrays.
+      wall_clock::time_point start = wall_clock::now();
+      int* occupancy = 0;
+      int* node_labels = 0;
+      try {
+        occupancy = hk_alloc_ints(N);
+        node_labels = hk_alloc_ints(N);
+      }
+      catch (const std::bad_alloc&) {
+        printf("%-12s %-12s could not allocate\n", page_names[pages],
+               numa_names[numa]);
+        hk_free_ints(occupancy, N);
+        continue;
+      }
+      #pragma omp parallel for schedule(static)
+      for (int i = 0; i < N; ++i) {
+        occupancy[i] = i;
+        node_labels[i] = 0;
+      }
+      double touch = seconds_since(start);
+
+      // Random reads across the whole array.
+      start = wall_clock::now();
+      #pragma omp parallel for schedule(static)
+      for (int i = 0; i < N; ++i)
+        node_labels[i] = occupancy[(unsigned int)(i * 2654435761u) % N];
+      double gather = seconds_since(start) / N * 1e9;
+
+      // A labelling whose internal arrays use the same policy.
+      MTRand rng(1);
+      for (int i = 0; i < N; ++i)
+        occupancy[i] = (rng() < p);
+      start = wall_clock::now();
+      extended_hk_lattice_runs(node_labels, occupancy, dims, 2, true);
+      double label = seconds_since(start);
+
+      printf("%-12s %-12s %10.3f %10.3f %10.3f\n", page_names[pages],
+             numa_names[numa], touch, gather, label);
+
+      hk_free_ints(occupancy, N);
+      hk_free_ints(node_labels, N);
+    }
+
+  return 0;
+}
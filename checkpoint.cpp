@@ -0,0 +1,148 @@
+/* Atomic checkpoints of random number streams and accumulated observables.
+ See checkpoint.h for the layout. */
+
+#include "checkpoint.h"
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const char checkpoint_magic[8] = {'H','K','C','H','K','P','T','1'};
+
+/* Appends raw bytes to a buffer. */
+
+static void put(vector<char>& buf, const void* p, size_t n) {
+  buf.insert(buf.end(), (const char*)p, (const char*)p + n);
+}
+
+/* Reads raw bytes from a buffer, failing at its end. */
+
+static bool get(const vector<char>& buf, size_t& pos, void* p, size_t n) {
+  if (pos + n > buf.size())
+    return false;
+  memcpy(p, &buf[pos], n);
+  pos += n;
+  return true;
+}
+
+static uint64_t fnv1a(const char* p, size_t n) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < n; ++i) {
+    h ^= (unsigned char)p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+bool write_checkpoint(const char* path, const vector<MTRand*>& streams,
+                      const vector<long long>& counters,
+                      const vector<double>& observables) {
+  vector<char> buf;
+  put(buf, checkpoint_magic, sizeof(checkpoint_magic));
+  const int64_t sizes[3] = {(int64_t)streams.size(), (int64_t)counters.size(),
+                            (int64_t)observables.size()};
+  put(buf, sizes, sizeof(sizes));
+
+  MTRand::uint32 state[MTRand::SAVE];
+  for (size_t s = 0; s < streams.size(); ++s) {
+    streams[s]->save(state);
+    for (int j = 0; j < MTRand::SAVE; ++j) {
+      uint32_t word = state[j];
+      put(buf, &word, sizeof(word));
+    }
+  }
+  for (size_t c = 0; c < counters.size(); ++c) {
+    int64_t counter = counters[c];
+    put(buf, &counter, sizeof(counter));
+  }
+  if (!observables.empty())
+    put(buf, &observables[0], observables.size() * sizeof(double));
+  const uint64_t hash = fnv1a(&buf[0], buf.size());
+  put(buf, &hash, sizeof(hash));
+
+  // Write a temporary file, get it onto the disk and move it into place.
+  const string tmp = string(path) + ".tmp";
+  FILE* f = fopen(tmp.c_str(), "wb");
+  if (!f)
+    return false;
+  bool ok = fwrite(&buf[0], 1, buf.size(), f) == buf.size()
+            && fflush(f) == 0 && fsync(fileno(f)) == 0;
+  ok = (fclose(f) == 0) && ok;
+  if (!ok || rename(tmp.c_str(), path) != 0) {
+    remove(tmp.c_str());
+    return false;
+  }
+
+  // Make the rename itself durable.
+  string dir(path);
+  const size_t slash = dir.rfind('/');
+  dir = (slash == string::npos) ? "." : dir.substr(0, slash + 1);
+  int fd = open(dir.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+  return true;
+}
+
+bool read_checkpoint(const char* path, const vector<MTRand*>& streams,
+                     vector<long long>& counters,
+                     vector<double>& observables) {
+  FILE* f = fopen(path, "rb");
+  if (!f)
+    return false;
+  vector<char> buf;
+  char block[1 << 16];
+  size_t n;
+  while ((n = fread(block, 1, sizeof(block), f)) > 0)
+    buf.insert(buf.end(), block, block + n);
+  fclose(f);
+
+  // Check the magic, the hash and the number of streams before using anything.
+  uint64_t hash;
+  if (buf.size() < sizeof(checkpoint_magic) + 3*8 + sizeof(hash)
+      || memcmp(&buf[0], checkpoint_magic, sizeof(checkpoint_magic)) != 0)
+    return false;
+  memcpy(&hash, &buf[buf.size() - sizeof(hash)], sizeof(hash));
+  buf.resize(buf.size() - sizeof(hash));
+  if (fnv1a(&buf[0], buf.size()) != hash)
+    return false;
+
+  size_t pos = sizeof(checkpoint_magic);
+  int64_t sizes[3];
+  if (!get(buf, pos, sizes, sizeof(sizes))
+      || sizes[0] != (int64_t)streams.size() || sizes[1] < 0 || sizes[2] < 0
+      || buf.size() != pos + sizes[0] * MTRand::SAVE * 4 + sizes[1] * 8
+                        + sizes[2] * sizeof(double))
+    return false;
+
+  // Read everything before changing anything.
+  vector<MTRand::uint32> states(streams.size() * MTRand::SAVE);
+  for (size_t j = 0; j < states.size(); ++j) {
+    uint32_t word;
+    if (!get(buf, pos, &word, sizeof(word)))
+      return false;
+    states[j] = word;
+  }
+  vector<long long> new_counters(sizes[1]);
+  for (int64_t c = 0; c < sizes[1]; ++c) {
+    int64_t counter;
+    if (!get(buf, pos, &counter, sizeof(counter)))
+      return false;
+    new_counters[c] = counter;
+  }
+  vector<double> new_observables(sizes[2]);
+  if (sizes[2] > 0
+      && !get(buf, pos, &new_observables[0], sizes[2] * sizeof(double)))
+    return false;
+
+  for (size_t s = 0; s < streams.size(); ++s)
+    streams[s]->load(&states[s * MTRand::SAVE]);
+  counters.swap(new_counters);
+  observables.swap(new_observables);
+  return true;
+}
@@ -0,0 +1,37 @@
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include "MersenneTwister.h"
+#include <vector>
+
+/* Checkpoints of long ensemble and sweep runs, so that a job killed at its
+ * wall-clock limit can carry on exactly where it stopped.
+ *
+ * A checkpoint holds the state of every random number stream (MTRand::save),
+ * integer counters such as the next realization or point of a sweep, and the
+ * observables accumulated so far. Integers are stored in host byte order.
+ *
+ *   bytes 0-7    magic "HKCHKPT1"
+ *   then         number of streams, counters and observables (8 bytes each)
+ *   then         MTRand::SAVE 4 byte words per stream
+ *   then         the counters (8 bytes each) and observables (doubles)
+ *   then         an 8 byte FNV-1a hash of everything before it
+ */
+
+/* Write a checkpoint to path. It is written to path.tmp, flushed to disk and
+ * renamed over path, so path always holds either the old or the new
+ * checkpoint, never a partial one.
+ */
+bool write_checkpoint(const char* path, const std::vector<MTRand*>& streams,
+                      const std::vector<long long>& counters,
+                      const std::vector<double>& observables);
+
+/* Read a checkpoint written by write_checkpoint and load the states into
+ * 'streams', which must have as many generators as the checkpoint. Returns
+ * false, leaving everything untouched, if there is no valid checkpoint.
+ */
+bool read_checkpoint(const char* path, const std::vector<MTRand*>& streams,
+                     std::vector<long long>& counters,
+                     std::vector<double>& observables);
+
+#endif /* CHECKPOINT_H_ */
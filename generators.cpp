@@ -0,0 +1,404 @@
+/* Generators for lattices and random graphs that fill the neighbour tables
+ used by extended_hk_graph directly, in parallel when built with -fopenmp.
+ The random graphs draw their numbers in fixed blocks of nodes (of stubs for
+ the random regular graphs), each with its own MTRand stream, so a seed gives
+ the same graph for any number of threads. */
+
+#include "generators.h"
+#include "MersenneTwister.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+hk_graph owned_graph::view() const {
+  hk_graph g = {N, degree, offsets.empty() ? 0 : &offsets[0],
+                nbs.empty() ? 0 : &nbs[0], 4};
+  return g;
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ * Lattices
+ * ---------------------------------------------------------------------------
+ */
+
+/* A bond from site 'from' of a cell to site 'to' of the cell shifted by
+ * 'shift' primitive vectors (each entry -1, 0 or 1).
+ */
+struct lattice_bond {
+  int from;
+  int to;
+  int shift[3];
+};
+
+static const lattice_bond triangular_bonds[] = {
+  {0,0,{1,0,0}}, {0,0,{0,1,0}}, {0,0,{1,-1,0}}};
+static const lattice_bond honeycomb_bonds[] = {
+  {0,1,{0,0,0}}, {0,1,{-1,0,0}}, {0,1,{0,-1,0}}};
+static const lattice_bond kagome_bonds[] = {
+  {0,1,{0,0,0}}, {0,2,{0,0,0}}, {1,2,{0,0,0}},
+  {0,1,{-1,0,0}}, {0,2,{0,-1,0}}, {1,2,{1,-1,0}}};
+static const lattice_bond bcc_bonds[] = {
+  {0,0,{1,0,0}}, {0,0,{0,1,0}}, {0,0,{0,0,1}}, {0,0,{1,1,1}}};
+static const lattice_bond fcc_bonds[] = {
+  {0,0,{1,0,0}}, {0,0,{0,1,0}}, {0,0,{0,0,1}},
+  {0,0,{1,-1,0}}, {0,0,{1,0,-1}}, {0,0,{0,1,-1}}};
+
+/* One neighbour of a site: site 'to' of the cell shifted by 'shift'. */
+
+struct lattice_link {
+  int to;
+  vector<int> shift;
+};
+
+/* The neighbours of each site of the basis, in the order they fill a row. */
+
+static void lattice_links(const lattice_bond* bonds, int n_bonds, int basis,
+                          int d, vector<vector<lattice_link> >& links) {
+  links.assign(basis, vector<lattice_link>());
+  for (int b = 0; b < n_bonds; ++b) {
+    lattice_link out, in;
+    out.to = bonds[b].to;
+    in.to = bonds[b].from;
+    for (int k = 0; k < d; ++k) {
+      out.shift.push_back(bonds[b].shift[k]);
+      in.shift.push_back(-bonds[b].shift[k]);
+    }
+    links[bonds[b].from].push_back(out);
+    links[bonds[b].to].push_back(in);
+  }
+}
+
+/* The links of a d-dimensional hypercubic lattice. */
+
+static void hypercubic_links(int d, vector<vector<lattice_link> >& links) {
+  links.assign(1, vector<lattice_link>());
+  for (int k = 0; k < d; ++k)
+    for (int s = 1; s >= -1; s -= 2) {
+      lattice_link l;
+      l.to = 0;
+      l.shift.assign(d, 0);
+      l.shift[k] = s;
+      links[0].push_back(l);
+    }
+}
+
+bool lattice_graph(owned_graph& g, lattice_type type, const int* dims, int d,
+                   bool periodic) {
+  const int want_d[] = {2, 2, 2, 2, 3, 3, 3, 0};
+  if (d < 1 || (want_d[type] && d != want_d[type]))
+    return false;
+
+  vector<vector<lattice_link> > links;
+  switch (type) {
+    case TRIANGULAR: lattice_links(triangular_bonds, 3, 1, d, links); break;
+    case HONEYCOMB:  lattice_links(honeycomb_bonds, 3, 2, d, links); break;
+    case KAGOME:     lattice_links(kagome_bonds, 6, 3, d, links); break;
+    case BCC:        lattice_links(bcc_bonds, 4, 1, d, links); break;
+    case FCC:        lattice_links(fcc_bonds, 6, 1, d, links); break;
+    default:         hypercubic_links(d, links); break;
+  }
+  const int basis = links.size();
+  int degree = 0;
+  for (int b = 0; b < basis; ++b)
+    degree = max(degree, (int)links[b].size());
+
+  // The nodes are indexed by int.
+  const int L = dims[0];
+  long long n_cells = 1;
+  for (int k = 0; k < d; ++k) {
+    if (dims[k] < 1)
+      return false;
+    n_cells *= dims[k];
+    if (n_cells * basis > 0x7FFFFFFF)
+      return false;
+  }
+  const long long n_rows = n_cells / L;
+
+  g.N = n_cells * basis;
+  g.degree = degree;
+  g.offsets.clear();
+  g.nbs.resize((long long)g.N * degree);
+
+  // Each row of cells along the first axis is filled by one thread. The other
+  // coordinates only change between rows, so their part of every neighbour
+  // index is worked out once per row.
+  #pragma omp parallel for schedule(static)
+  for (long long r = 0; r < n_rows; ++r) {
+    vector<int> coords(d, 0);
+    long long rest = r;
+    for (int k = 1; k < d; ++k) {
+      coords[k] = rest % dims[k];
+      rest /= dims[k];
+    }
+
+    // For every link: whether it stays inside the lattice off the first axis,
+    // and the index of the target row.
+    vector<vector<long long> > target_row(basis);
+    for (int b = 0; b < basis; ++b)
+      for (size_t l = 0; l < links[b].size(); ++l) {
+        long long row = 0, stride = 1;
+        for (int k = 1; k < d; ++k) {
+          int c = coords[k] + links[b][l].shift[k];
+          if (c < 0 || c >= dims[k]) {
+            if (!periodic) {
+              row = -1;
+              break;
+            }
+            c = (c + dims[k]) % dims[k];
+          }
+          row += c * stride;
+          stride *= dims[k];
+        }
+        target_row[b].push_back(row);
+      }
+
+    for (int x = 0; x < L; ++x)
+      for (int b = 0; b < basis; ++b) {
+        int* nbs = &g.nbs[((r*L + x)*basis + b) * degree];
+        int n_nbs = 0;
+        for (size_t l = 0; l < links[b].size(); ++l) {
+          int nx = x + links[b][l].shift[0];
+          if (nx < 0 || nx >= L) {
+            if (!periodic)
+              continue;
+            nx = (nx < 0) ? nx + L : nx - L;
+          }
+          if (target_row[b][l] < 0)
+            continue;
+          nbs[n_nbs++] = (target_row[b][l]*L + nx)*basis + links[b][l].to;
+        }
+        for (; n_nbs < degree; ++n_nbs)
+          nbs[n_nbs] = -1;
+      }
+  }
+  return true;
+}
+
+/* Primitive vectors (rows) and basis positions of the 2D and 3D lattices. */
+
+static const double r3 = 0.86602540378443864676; // sqrt(3)/2
+static const double triangular_vectors[] = {1,0,0, 0.5,r3,0};
+static const double bcc_vectors[] = {-0.5,0.5,0.5, 0.5,-0.5,0.5, 0.5,0.5,-0.5};
+static const double fcc_vectors[] = {0,0.5,0.5, 0.5,0,0.5, 0.5,0.5,0};
+static const double origin[] = {0,0,0};
+static const double honeycomb_basis[] = {0,0,0, 0.5,r3/3,0};
+static const double kagome_basis[] = {0,0,0, 0.5,0,0, 0.25,r3/2,0};
+
+bool lattice_positions(vector<double>& coords, lattice_type type,
+                       const int* dims, int d) {
+  const int want_d[] = {2, 2, 2, 2, 3, 3, 3, 0};
+  if (d < 1 || (want_d[type] && d != want_d[type]))
+    return false;
+
+  const double* vectors = 0; // null for unit vectors
+  const double* basis_positions = origin;
+  int basis = 1;
+  switch (type) {
+    case TRIANGULAR: vectors = triangular_vectors; break;
+    case HONEYCOMB:  vectors = triangular_vectors;
+                     basis_positions = honeycomb_basis; basis = 2; break;
+    case KAGOME:     vectors = triangular_vectors;
+                     basis_positions = kagome_basis; basis = 3; break;
+    case BCC:        vectors = bcc_vectors; break;
+    case FCC:        vectors = fcc_vectors; break;
+    default:         break;
+  }
+
+  long long n_cells = 1;
+  for (int k = 0; k < d; ++k)
+    n_cells *= dims[k];
+  const int L = dims[0];
+  const long long n_rows = n_cells / L;
+  coords.resize(n_cells * basis * d);
+
+  #pragma omp parallel for schedule(static)
+  for (long long r = 0; r < n_rows; ++r) {
+    // Position of the start of the row.
+    vector<double> row(d, 0.0);
+    long long rest = r;
+    for (int k = 1; k < d; ++k) {
+      const int c = rest % dims[k];
+      rest /= dims[k];
+      for (int j = 0; j < d; ++j)
+        row[j] += vectors ? c * vectors[3*k + j] : (j == k ? c : 0);
+    }
+
+    double* pos = &coords[r * L * basis * d];
+    for (int x = 0; x < L; ++x)
+      for (int b = 0; b < basis; ++b, pos += d)
+        for (int j = 0; j < d; ++j)
+          pos[j] = row[j] + basis_positions[3*b + j]
+                   + (vectors ? x * vectors[j] : (j == 0 ? x : 0));
+  }
+  return true;
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ * Random graphs
+ * ---------------------------------------------------------------------------
+ */
+
+/* The random graphs draw their edges in this many blocks of nodes. */
+
+static int n_blocks(int N) {
+  return max(1, min(N, 1024));
+}
+
+static int block_start(int N, int block) {
+  return (long long)N * block / n_blocks(N);
+}
+
+/* Build a table with offsets from undirected edges drawn per block. The
+ * neighbours of each node end up sorted.
+ */
+static void from_edges(owned_graph& g, int N,
+                       const vector<vector<pair<int, int> > >& edges) {
+  const int blocks = edges.size();
+  g.N = N;
+  g.degree = 0;
+  g.offsets.assign(N + 1, 0);
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int b = 0; b < blocks; ++b)
+    for (size_t e = 0; e < edges[b].size(); ++e) {
+      #pragma omp atomic
+      g.offsets[edges[b][e].first + 1]++;
+      #pragma omp atomic
+      g.offsets[edges[b][e].second + 1]++;
+    }
+  for (int i = 0; i < N; ++i)
+    g.offsets[i+1] += g.offsets[i];
+
+  vector<long long> next(g.offsets.begin(), g.offsets.end() - 1);
+  g.nbs.resize(g.offsets[N]);
+  #pragma omp parallel for schedule(dynamic)
+  for (int b = 0; b < blocks; ++b)
+    for (size_t e = 0; e < edges[b].size(); ++e) {
+      const int u = edges[b][e].first, v = edges[b][e].second;
+      long long slot;
+      #pragma omp atomic capture
+      slot = next[u]++;
+      g.nbs[slot] = v;
+      #pragma omp atomic capture
+      slot = next[v]++;
+      g.nbs[slot] = u;
+    }
+
+  #pragma omp parallel for schedule(dynamic, 4096)
+  for (int i = 0; i < N; ++i)
+    sort(g.nbs.begin() + g.offsets[i], g.nbs.begin() + g.offsets[i+1]);
+}
+
+void edge_list_graph(owned_graph& g, int N,
+                     const vector<pair<int, int> >& edges) {
+  from_edges(g, N, vector<vector<pair<int, int> > >(1, edges));
+}
+
+bool random_regular_graph(owned_graph& g, int N, int k, unsigned long seed) {
+  const long long n_stubs = (long long)N * k;
+  if (N < 0 || k < 0 || n_stubs % 2)
+    return false;
+
+  // Shuffle the stubs in parallel: every block of stubs throws its stubs into
+  // random buckets with its own stream, the buckets are laid out one after
+  // another and each is shuffled with a stream of its own. The blocks keep
+  // their order within a bucket, so the result depends on the seed only.
+  const long long blocks = max(1LL, min(n_stubs, 1024LL));
+  const long long buckets = blocks;
+  vector<long long> counts(blocks * buckets, 0);
+  #pragma omp parallel for schedule(static)
+  for (long long b = 0; b < blocks; ++b) {
+    MTRand rng(seed + b);
+    for (long long s = n_stubs * b / blocks; s < n_stubs * (b+1) / blocks; ++s)
+      counts[b * buckets + rng.randInt(buckets - 1)]++;
+  }
+
+  // Where each block starts in each bucket, bucket by bucket.
+  vector<long long> starts(blocks * buckets);
+  vector<long long> bucket_start(buckets + 1, 0);
+  long long next = 0;
+  for (long long c = 0; c < buckets; ++c) {
+    bucket_start[c] = next;
+    for (long long b = 0; b < blocks; ++b) {
+      starts[b * buckets + c] = next;
+      next += counts[b * buckets + c];
+    }
+  }
+  bucket_start[buckets] = next;
+
+  // Draw the same buckets again and scatter the stubs.
+  vector<long long> stubs(n_stubs);
+  #pragma omp parallel for schedule(static)
+  for (long long b = 0; b < blocks; ++b) {
+    MTRand rng(seed + b);
+    long long* start = &starts[b * buckets];
+    for (long long s = n_stubs * b / blocks; s < n_stubs * (b+1) / blocks; ++s)
+      stubs[start[rng.randInt(buckets - 1)]++] = s;
+  }
+
+  #pragma omp parallel for schedule(dynamic)
+  for (long long c = 0; c < buckets; ++c) {
+    MTRand rng(seed + blocks + c);
+    const long long lo = bucket_start[c];
+    for (long long s = bucket_start[c+1] - 1; s > lo; --s)
+      swap(stubs[s], stubs[lo + rng.randInt(s - lo)]);
+  }
+
+  // Pair up consecutive stubs. Stub s belongs to node s/k, so the pairing can
+  // be written straight into the rows.
+  g.N = N;
+  g.degree = k;
+  g.offsets.clear();
+  g.nbs.resize(n_stubs);
+  #pragma omp parallel for schedule(static)
+  for (long long s = 0; s < n_stubs; s += 2) {
+    g.nbs[stubs[s]] = stubs[s+1] / k;
+    g.nbs[stubs[s+1]] = stubs[s] / k;
+  }
+  return true;
+}
+
+void erdos_renyi_graph(owned_graph& g, int N, double p, unsigned long seed) {
+  const int blocks = n_blocks(N);
+  vector<vector<pair<int, int> > > edges(blocks);
+
+  // Draw the edges (i, j), j > i, of each row by skipping geometrically
+  // distributed numbers of non-edges.
+  if (p > 0) {
+    const double log_q = log(1.0 - min(p, 1.0));
+    #pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < blocks; ++b) {
+      MTRand rng(seed + b);
+      for (int i = block_start(N, b); i < block_start(N, b + 1); ++i)
+        for (long long j = i; ; ) {
+          j += (p >= 1) ? 1 : 1 + (long long)(log(1.0 - rng.randExc()) / log_q);
+          if (j >= N)
+            break;
+          edges[b].push_back(make_pair(i, (int)j));
+        }
+    }
+  }
+  from_edges(g, N, edges);
+}
+
+void small_world_graph(owned_graph& g, int N, int k, double beta,
+                       unsigned long seed) {
+  const int blocks = n_blocks(N);
+  vector<vector<pair<int, int> > > edges(blocks);
+
+  #pragma omp parallel for schedule(static)
+  for (int b = 0; b < blocks; ++b) {
+    MTRand rng(seed + b);
+    for (int i = block_start(N, b); i < block_start(N, b + 1); ++i)
+      for (int s = 1; s <= k/2; ++s) {
+        int j = (i + s) % N;
+        if (rng() < beta)
+          do j = rng.randInt(N - 1); while (j == i && N > 1);
+        edges[b].push_back(make_pair(i, j));
+      }
+  }
+  from_edges(g, N, edges);
+}
@@ -0,0 +1,79 @@
+#ifndef GENERATORS_H_
+#define GENERATORS_H_
+
+#include "hk.h"
+#include <utility>
+#include <vector>
+
+/* A neighbour table that owns its storage, in the layout of hk_graph.
+ * -degree > 0: nbs holds N rows of 'degree' entries, padded with -1 at the end
+ *  of a row where a node has fewer neighbours.
+ * -degree == 0: the neighbours of node i are nbs[offsets[i]..offsets[i+1]).
+ */
+struct owned_graph {
+  int N;
+  int degree;
+  std::vector<long long> offsets;
+  std::vector<int> nbs;
+
+  hk_graph view() const;
+};
+
+/* The lattices that lattice_graph can build. Every lattice is a Bravais
+ * lattice with a basis, and node b of cell (x_0, ..., x_{d-1}) has index
+ * b + basis*(x_0 + dims[0]*(x_1 + dims[1]*(...))). The cells are indexed by
+ * their primitive vectors, so with open boundaries the triangular, honeycomb,
+ * kagome, BCC and FCC samples are rhombic rather than rectangular.
+ */
+enum lattice_type {
+  SQUARE,       // d = 2, 4 neighbours
+  TRIANGULAR,   // d = 2, 6 neighbours
+  HONEYCOMB,    // d = 2, 2 sites per cell, 3 neighbours
+  KAGOME,       // d = 2, 3 sites per cell, 4 neighbours
+  SIMPLE_CUBIC, // d = 3, 6 neighbours
+  BCC,          // d = 3, 8 neighbours
+  FCC,          // d = 3, 12 neighbours
+  HYPERCUBIC    // any d, 2d neighbours
+};
+
+/* Build a lattice of dims[0] x ... x dims[d-1] cells with open or periodic
+ * boundaries, filling the rows in parallel. Periodic sides shorter than 3
+ * give repeated neighbours. Returns false if d does not suit the lattice or
+ * the number of nodes does not fit an int.
+ */
+bool lattice_graph(owned_graph& g, lattice_type type, const int* dims, int d,
+                   bool periodic);
+
+/* The positions of the nodes of lattice_graph(g, type, dims, d, periodic), d
+ * coordinates per node, for extended_hk_geometry. The primitive vectors have
+ * length 1 in 2D (so the honeycomb and kagome bonds are 1/sqrt(3) and 1/2),
+ * and BCC and FCC have a conventional cubic cell of side 1. The positions are
+ * those of the open lattice, so a cluster that wraps around a periodic
+ * boundary gets the centre and extent of its pieces taken together.
+ */
+bool lattice_positions(std::vector<double>& coords, lattice_type type,
+                       const int* dims, int d);
+
+/* A graph of N nodes with offsets, from a list of undirected edges. The
+ * neighbours of each node end up sorted.
+ */
+void edge_list_graph(owned_graph& g, int N,
+                     const std::vector<std::pair<int, int> >& edges);
+
+/* A random k-regular graph from the configuration model. Self-loops and
+ * repeated edges are kept, so every node has exactly k neighbours. N*k must
+ * be even.
+ */
+bool random_regular_graph(owned_graph& g, int N, int k, unsigned long seed);
+
+/* An Erdos-Renyi G(N, p) graph. */
+void erdos_renyi_graph(owned_graph& g, int N, double p, unsigned long seed);
+
+/* A Watts-Strogatz small-world graph: a ring where every node is joined to
+ * its k/2 nearest neighbours on each side, after which the far end of every
+ * bond is moved to a random node with probability beta.
+ */
+void small_world_graph(owned_graph& g, int N, int k, double beta,
+                       unsigned long seed);
+
+#endif /* GENERATORS_H_ */
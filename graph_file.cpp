@@ -0,0 +1,193 @@
+/* Binary neighbour tables that can be memory-mapped and handed to
+ extended_hk_graph without any copying. See graph_file.h for the layout. */
+
+#include "graph_file.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const char graph_magic[8] = {'H','K','G','R','A','P','H','1'};
+static const size_t header_bytes = 64;
+
+struct graph_header {
+  char magic[8];
+  int index_bytes;
+  int degree;
+  long long N;
+  long long n_entries;
+  char reserved[32];
+};
+
+/* Entry j of the neighbour array of g as an int, with padding as -1. */
+
+static int graph_entry(const hk_graph& g, long long j) {
+  if (g.index_bytes == 2) {
+    unsigned short nb = ((const unsigned short*)g.nbs)[j];
+    return nb == 0xFFFF ? -1 : nb;
+  }
+  return ((const int*)g.nbs)[j];
+}
+
+/* Append one neighbour entry of the given width to the buffer. */
+
+static void put_entry(vector<char>& buf, int nb, int index_bytes) {
+  if (index_bytes == 2) {
+    unsigned short v = (nb == -1) ? 0xFFFF : (unsigned short)nb;
+    buf.insert(buf.end(), (char*)&v, (char*)&v + 2);
+  }
+  else
+    buf.insert(buf.end(), (char*)&nb, (char*)&nb + 4);
+}
+
+static bool write_header(FILE* f, int index_bytes, int degree, long long N,
+                         long long n_entries) {
+  graph_header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, graph_magic, sizeof(graph_magic));
+  h.index_bytes = index_bytes;
+  h.degree = degree;
+  h.N = N;
+  h.n_entries = n_entries;
+  return fwrite(&h, sizeof(h), 1, f) == 1;
+}
+
+static bool width_fits(int N, int index_bytes) {
+  return index_bytes == 4 || (index_bytes == 2 && N < 0xFFFF);
+}
+
+bool write_graph_file(const char* path, const hk_graph& g, int index_bytes) {
+  if (!width_fits(g.N, index_bytes))
+    return false;
+  FILE* f = fopen(path, "wb");
+  if (!f)
+    return false;
+
+  const long long n_entries = (g.degree > 0) ? (long long)g.N * g.degree
+                                             : g.offsets[g.N];
+  bool ok = write_header(f, index_bytes, g.degree, g.N, n_entries);
+  if (ok && g.degree == 0)
+    ok = fwrite(g.offsets, sizeof(long long), g.N + 1, f) == (size_t)g.N + 1;
+
+  // Write the neighbours in blocks, converting the width on the way.
+  vector<char> buf;
+  const long long block = 1 << 16;
+  for (long long j0 = 0; ok && j0 < n_entries; j0 += block) {
+    buf.clear();
+    for (long long j = j0; j < min(j0 + block, n_entries); ++j)
+      put_entry(buf, graph_entry(g, j), index_bytes);
+    ok = fwrite(&buf[0], 1, buf.size(), f) == buf.size();
+  }
+
+  return (fclose(f) == 0) && ok;
+}
+
+bool write_graph_file(const char* path, int const* const* nbs, int N, int m,
+                      int index_bytes) {
+  if (!width_fits(N, index_bytes))
+    return false;
+
+  // Count the neighbours of each row, ignoring the -1 padding.
+  vector<long long> offsets(N + 1, 0);
+  bool padded = false;
+  for (int i = 0; i < N; ++i) {
+    int n_nbs = m;
+    while (n_nbs > 0 && nbs[i][n_nbs - 1] == -1)
+      n_nbs--;
+    padded = padded || (n_nbs != m);
+    offsets[i+1] = offsets[i] + n_nbs;
+  }
+
+  FILE* f = fopen(path, "wb");
+  if (!f)
+    return false;
+
+  bool ok = write_header(f, index_bytes, padded ? 0 : m, N, offsets[N]);
+  if (ok && padded)
+    ok = fwrite(&offsets[0], sizeof(long long), N + 1, f) == (size_t)N + 1;
+
+  vector<char> buf;
+  for (int i = 0; ok && i < N; ++i) {
+    buf.clear();
+    for (long long j = 0; j < offsets[i+1] - offsets[i]; ++j)
+      put_entry(buf, nbs[i][j], index_bytes);
+    ok = buf.empty() || fwrite(&buf[0], 1, buf.size(), f) == buf.size();
+  }
+
+  return (fclose(f) == 0) && ok;
+}
+
+/* The offsets must rise from the start of the neighbour array to its end, so
+ that every row lies inside it. */
+
+static bool offsets_valid(const long long* offsets, long long N,
+                          long long n_entries) {
+  if (offsets[0] != 0 || offsets[N] != n_entries)
+    return false;
+  for (long long i = 0; i < N; ++i)
+    if (offsets[i] > offsets[i+1])
+      return false;
+  return true;
+}
+
+bool map_graph_file(const char* path, mapped_graph& mg) {
+  mg.base = 0;
+  mg.length = 0;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < header_bytes) {
+    close(fd);
+    return false;
+  }
+  void* base = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); // The mapping keeps the file alive.
+  if (base == MAP_FAILED)
+    return false;
+
+  // Check the header against the size of the file, and the table against
+  // the header.
+  const graph_header* h = (const graph_header*)base;
+  const size_t offsets_bytes = (h->degree == 0) ? (h->N + 1) * 8 : 0;
+  const char* data = (const char*)base + header_bytes;
+  const bool valid = memcmp(h->magic, graph_magic, sizeof(graph_magic)) == 0
+      && h->degree >= 0 && h->N >= 0 && h->N < 0x7FFFFFFF
+      && width_fits(h->N, h->index_bytes)
+      && h->n_entries >= 0 && h->n_entries <= st.st_size
+      && (size_t)st.st_size == header_bytes + offsets_bytes
+                               + h->n_entries * h->index_bytes
+      && (h->degree > 0 ? h->n_entries == h->N * h->degree
+                        : offsets_valid((const long long*)data, h->N,
+                                        h->n_entries));
+  if (!valid) {
+    munmap(base, st.st_size);
+    return false;
+  }
+
+  // Start reading the table in. The pages stay in the page cache for the
+  // next realization and for other processes mapping the same file.
+  madvise(base, st.st_size, MADV_WILLNEED);
+
+  mg.graph.N = h->N;
+  mg.graph.degree = h->degree;
+  mg.graph.offsets = (h->degree == 0) ? (const long long*)data : 0;
+  mg.graph.nbs = data + offsets_bytes;
+  mg.graph.index_bytes = h->index_bytes;
+  mg.base = base;
+  mg.length = st.st_size;
+  return true;
+}
+
+void unmap_graph_file(mapped_graph& mg) {
+  if (mg.base)
+    munmap(mg.base, mg.length);
+  mg.base = 0;
+  mg.length = 0;
+}
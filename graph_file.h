@@ -0,0 +1,53 @@
+#ifndef GRAPH_FILE_H_
+#define GRAPH_FILE_H_
+
+#include "hk.h"
+#include <cstddef>
+
+/* A compact binary file holding a neighbour table in the layout of hk_graph,
+ * so that it can be mapped into memory and labelled without being rebuilt.
+ * Integers are stored in host byte order.
+ *
+ *   bytes 0-7    magic "HKGRAPH1"
+ *   bytes 8-11   index_bytes (2 or 4)
+ *   bytes 12-15  degree (0 if offsets are stored)
+ *   bytes 16-23  N
+ *   bytes 24-31  number of entries in the neighbour array
+ *   bytes 32-63  reserved, zero
+ *   then         N+1 offsets as 8 byte integers, if degree == 0
+ *   then         the neighbour array, index_bytes per entry
+ */
+
+/* A graph file mapped into memory. 'graph' points into the mapping and is
+ * valid until unmap_graph_file is called.
+ */
+struct mapped_graph {
+  hk_graph graph;
+  void* base;
+  size_t length;
+};
+
+/* Write g to path, narrowing the neighbour entries to index_bytes (2 or 4).
+ * Returns false if the file cannot be written or N does not fit the width.
+ */
+bool write_graph_file(const char* path, const hk_graph& g, int index_bytes);
+
+/* Write an N x m table in the layout of extended_hk_no_boost to path. Rows
+ * may be padded with -1. If any row is padded the file stores offsets and
+ * drops the padding, otherwise it stores a fixed degree m.
+ */
+bool write_graph_file(const char* path, int const* const* nbs, int N, int m,
+                      int index_bytes);
+
+/* Map the graph file at path read-only. Several processes mapping the same
+ * file share one copy in the page cache. Returns false if the file cannot be
+ * opened or is not a valid graph file: the sizes in the header must match
+ * the file, 2 byte entries need N < 0xFFFF as for write_graph_file, and the
+ * offsets must rise from 0 to the number of entries. The offsets are
+ * checked in one pass over them, the neighbours are not read.
+ */
+bool map_graph_file(const char* path, mapped_graph& mg);
+
+void unmap_graph_file(mapped_graph& mg);
+
+#endif /* GRAPH_FILE_H_ */
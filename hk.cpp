@@ -5,6 +5,8 @@
  Requirements:
  -Boost
  -compiler ? - ?
+ -OpenMP (optional, -fopenmp parallelises the relabelling pass)
+ -allocator.cpp (page size and NUMA placement of the large arrays)
 
  Copyright (c) September 9, 2000, by Tobin Fricke <tobin@pas.rochester.edu>
 
@@ -16,10 +18,17 @@
  http://www.ocf.berkeley.edu/~fricke/projects/hoshenkopelman/hoshenkopelman.html
  */
 
+#include "hk.h"
+#include "allocator.h"
 #include <boost/multi_array.hpp>
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <new>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
@@ -33,6 +42,51 @@ using namespace std;
 int *labels;
 int n_labels = 0; /* length of the labels array */
 
+/* If not null, cluster_sizes[x] is the number of nodes in the class of x while x is a root.
+ The labelers that use it allocate it next to 'labels' and count the nodes themselves. */
+
+int *cluster_sizes = 0;
+
+/* If not null, cluster_moments holds 3*moment_dim+1 numbers per label: the sums of the
+ coordinates and of the squared distance from the origin of the nodes in the class, and the
+ minimum and maximum of each coordinate. Like cluster_sizes it is only valid at the roots. */
+
+double *cluster_moments = 0;
+int moment_dim = 0;
+
+static void moments_clear(int x) {
+  double* m = cluster_moments + (long long)x * (3*moment_dim + 1);
+  for (int k = 0; k <= moment_dim; ++k)
+    m[k] = 0;
+  for (int k = 0; k < moment_dim; ++k) {
+    m[moment_dim + 1 + k] = HUGE_VAL;
+    m[2*moment_dim + 1 + k] = -HUGE_VAL;
+  }
+}
+
+/* Add the moments of the class of y onto those of x, or of a single node if y is null. */
+
+static void moments_add(int x, const double* y, const double* coords) {
+  const int d = moment_dim;
+  double* m = cluster_moments + (long long)x * (3*d + 1);
+  if (y) {
+    for (int k = 0; k <= d; ++k)
+      m[k] += y[k];
+    for (int k = 0; k < d; ++k) {
+      m[d + 1 + k] = min(m[d + 1 + k], y[d + 1 + k]);
+      m[2*d + 1 + k] = max(m[2*d + 1 + k], y[2*d + 1 + k]);
+    }
+  }
+  else {
+    for (int k = 0; k < d; ++k) {
+      m[k] += coords[k];
+      m[d] += coords[k] * coords[k];
+      m[d + 1 + k] = min(m[d + 1 + k], coords[k]);
+      m[2*d + 1 + k] = max(m[2*d + 1 + k], coords[k]);
+    }
+  }
+}
+
 /*  uf_find returns the canonical label for the equivalence class containing x */
 
 int uf_find(int x) {
@@ -48,10 +102,20 @@ int uf_find(int x) {
   return y;
 }
 
-/*  uf_union joins two equivalence classes and returns the canonical label of the resulting class. */
+/*  uf_union joins two equivalence classes and returns the canonical label of the resulting class.
+ The smaller root always becomes the parent, so a class is named by the first label it was
+ given and labels[x] <= x holds throughout. */
 
 int uf_union(int x, int y) {
-  return labels[uf_find(x)] = uf_find(y);
+  int rx = uf_find(x);
+  int ry = uf_find(y);
+  if (rx > ry)
+    swap(rx, ry);
+  if (cluster_sizes && rx != ry)
+    cluster_sizes[rx] += cluster_sizes[ry];
+  if (cluster_moments && rx != ry)
+    moments_add(rx, cluster_moments + (long long)ry * (3*moment_dim + 1), 0);
+  return labels[ry] = rx;
 }
 
 /*  uf_make_set creates a new equivalence class and returns its label */
@@ -60,6 +124,10 @@ int uf_make_set(void) {
   labels[0]++;
   assert(labels[0] < n_labels);
   labels[labels[0]] = labels[0];
+  if (cluster_sizes)
+    cluster_sizes[labels[0]] = 0;
+  if (cluster_moments)
+    moments_clear(labels[0]);
   return labels[0];
 }
 
@@ -67,18 +135,127 @@ int uf_make_set(void) {
 
 void uf_initialize(int max_labels) {
   n_labels = max_labels;
-  labels = new int[n_labels];
+  labels = hk_alloc_ints(n_labels);
   labels[0] = 0;
 }
 
 /*  uf_done frees the memory used by the union-find data structures */
 
 void uf_done(void) {
+  hk_free_ints(labels, n_labels);
   n_labels = 0;
-  delete[] labels;
   labels = 0;
 }
 
+/*  inclusive_scan replaces a[i] by a[0] + ... + a[i]. Each thread scans one block, the block
+ totals are scanned serially and then added back onto the blocks in parallel. */
+
+static void inclusive_scan(int* a, int n) {
+#ifdef _OPENMP
+  const int n_blocks = omp_get_max_threads();
+#else
+  const int n_blocks = 1;
+#endif
+  std::vector<int> offsets(n_blocks + 1, 0);
+
+  #pragma omp parallel for schedule(static, 1)
+  for (int b = 0; b < n_blocks; ++b) {
+    const int lo = (long long)n * b / n_blocks;
+    const int hi = (long long)n * (b + 1) / n_blocks;
+    for (int i = lo + 1; i < hi; ++i)
+      a[i] += a[i - 1];
+    offsets[b + 1] = (lo < hi) ? a[hi - 1] : 0;
+  }
+
+  for (int b = 0; b < n_blocks; ++b)
+    offsets[b + 1] += offsets[b];
+
+  #pragma omp parallel for schedule(static, 1)
+  for (int b = 1; b < n_blocks; ++b) {
+    const int lo = (long long)n * b / n_blocks;
+    const int hi = (long long)n * (b + 1) / n_blocks;
+    for (int i = lo; i < hi; ++i)
+      a[i] += offsets[b];
+  }
+}
+
+/*  uf_canonicalise replaces the labels of the occupied nodes with sequential labels 1, 2, ...
+ in order of first occurrence, and those of the empty nodes with 0.
+
+ This used to be a serial loop that handed out new_labels[0]++ the first time a root was
+ seen. Labels are created in node order and uf_union keeps the smaller root, so the roots
+ in label order already are the clusters in order of first occurrence. The new label of a
+ root is therefore the number of roots at or below it, which is a prefix sum over root flags,
+ and the final gather over the nodes is independent per node.
+
+ uf_find compresses the paths it walks, but uf_union hangs a whole root under another, and
+ labels that are never looked up again keep pointing at a root that has since been linked
+ away. The chains can be as long as the number of labels, so the forest is flattened first by
+ pointer jumping, which halves the depth of every chain in each parallel round. The gather
+ then needs a single lookup per node.
+
+ If a writer is given, the nodes are relabelled in blocks and every block is handed to the
+ writer as soon as it is done, so the labels can be written out without a second copy.
+ Returns false if the writer fails. */
+
+static bool uf_canonicalise(int* node_labels, const int* occupancy, int N,
+                            hk_label_writer* writer = 0) {
+  const int n = labels[0] + 1;
+  int *new_labels = hk_alloc_ints(n);
+
+  // Jump between labels and new_labels, so that no round reads what it writes. The forest
+  // is flat once a round changes nothing.
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    #pragma omp parallel for schedule(static)
+    for (int x = 1; x < n; ++x)
+      new_labels[x] = labels[labels[x]];
+    #pragma omp parallel for schedule(static) reduction(||:changed)
+    for (int x = 1; x < n; ++x) {
+      labels[x] = new_labels[new_labels[x]];
+      changed = changed || (labels[x] != new_labels[x]);
+    }
+  }
+
+  new_labels[0] = 0;
+  #pragma omp parallel for schedule(static)
+  for (int x = 1; x < n; ++x)
+    new_labels[x] = (labels[x] == x);
+
+  inclusive_scan(new_labels, n);
+
+  bool ok = true;
+  if (writer) {
+    // Sizes of the clusters in their new order, if they were counted.
+    const int n_clusters = new_labels[n-1];
+    std::vector<int> sizes;
+    if (cluster_sizes) {
+      sizes.resize(n_clusters);
+      #pragma omp parallel for schedule(static)
+      for (int x = 1; x < n; ++x)
+        if (labels[x] == x)
+          sizes[new_labels[x] - 1] = cluster_sizes[x];
+    }
+    ok = writer->begin(N, n_clusters, sizes.empty() ? 0 : &sizes[0]);
+  }
+
+  const int block = writer ? (1 << 16) : max(N, 1);
+  for (int lo = 0; ok && lo < N; lo += block) {
+    const int hi = min(N, lo + block);
+    #pragma omp parallel for schedule(static)
+    for (int i = lo; i < hi; ++i)
+      node_labels[i] = occupancy[i] ? new_labels[labels[node_labels[i]]] : 0;
+    if (writer)
+      ok = writer->write(node_labels + lo, lo, hi - lo);
+  }
+  if (writer && ok)
+    ok = writer->finish();
+
+  hk_free_ints(new_labels, n);
+  return ok;
+}
+
 /* End Union-Find implementation */
 
 /* A generalized version of the HK algorithm for arbitrary networks of nodes.
@@ -157,28 +334,8 @@ void extended_hoshen_kopelman(boost::multi_array<int, 1>& node_labels,
     } //occupancy
   } //node
 
-  /* This is a little bit sneaky.. we create a mapping from the canonical labels
-   determined by union/find into a new set of canonical labels, which are
-   guaranteed to be sequential. */
-
-  int *new_labels = new int[n_labels]; // allocate array, initialized to zero
-  for (int i = 0; i < n_labels; i++) new_labels[i] = 0;
-
-  for (int i = 0; i < N; i++)
-    if (occupancy[i]) {
-      int x = uf_find(node_labels[i]);
-      if (new_labels[x] == 0) {
-        new_labels[0]++;
-        new_labels[x] = new_labels[0];
-      }
-      node_labels[i] = new_labels[x];
-    }
-    else {
-      node_labels[i] = 0; // Replace placeholders with 0.
-    }
-
-  // Cleanup
-  delete[] new_labels;
+  // Map the union/find labels onto sequential labels and clean up.
+  uf_canonicalise(node_labels.data(), occupancy.data(), N);
   uf_done();
 }
 
@@ -245,27 +402,520 @@ void extended_hk_no_boost(int* node_labels, int const* const* nbs,
     } //occupancy
   } //node
 
-  /* This is a little bit sneaky.. we create a mapping from the canonical labels
-   determined by union/find into a new set of canonical labels, which are
-   guaranteed to be sequential. */
+  // Map the union/find labels onto sequential labels and clean up.
+  uf_canonicalise(node_labels, occupancy, N);
+  uf_done();
+}
 
-  int *new_labels = new int[n_labels]; // allocate array, initialized to zero
-  for (int i = 0; i < n_labels; i++) new_labels[i] = 0;
+/* The sweep of extended_hk_graph for one index width. Rows may be padded with
+ * (Index)-1 when the table has a fixed degree. Row i belongs to node first+i,
+ * and neighbours outside [first, first+N) are ignored. If cluster_moments is
+ * set, coords holds moment_dim coordinates per node.
+ */
+template <typename Index>
+static void hk_graph_sweep(int* node_labels, const hk_graph& g,
+                           const Index* nbs, const int* occupancy, int first,
+                           const double* coords = 0) {
+  const int N = g.N;
+  const int unlabelled = N+1;
+  const Index none = (Index)-1;
 
-  for (int i = 0; i < N; i++)
+  for (int i = 0; i < N; ++i) {
     if (occupancy[i]) {
-      int x = uf_find(node_labels[i]);
-      if (new_labels[x] == 0) {
-        new_labels[0]++;
-        new_labels[x] = new_labels[0];
+
+      // Get neighbours of node i.
+      long long begin, end;
+      if (g.degree > 0) {
+        begin = (long long)i * g.degree;
+        end = begin + g.degree;
+      }
+      else {
+        begin = g.offsets[i];
+        end = g.offsets[i+1];
+      }
+
+      // Find smallest label of the neighbours.
+      int min_label = unlabelled;
+      for (long long j = begin; j < end; ++j) {
+        const unsigned int nb = (int)nbs[j] - first;
+        if (nbs[j] != none && nb < (unsigned int)N)
+          min_label = min(min_label, node_labels[nb]);
+      }
+
+      // Labelling + merging
+      if (min_label == unlabelled)
+        node_labels[i] = uf_make_set();
+      else {
+        node_labels[i] = min_label;
+        for (long long j = begin; j < end; ++j) {
+          const unsigned int nb = (int)nbs[j] - first;
+          if (nbs[j] == none || nb >= (unsigned int)N)
+            continue;
+          int nb_label = node_labels[nb];
+          if (nb_label != unlabelled && nb_label != min_label)
+            uf_union(min_label, nb_label);
+        }
+      }
+
+      if (cluster_sizes)
+        cluster_sizes[uf_find(node_labels[i])]++;
+      if (cluster_moments)
+        moments_add(uf_find(node_labels[i]), 0,
+                    coords + (long long)i * moment_dim);
+
+    } //occupancy
+  } //node
+}
+
+/* A flavour of extended_hk_no_boost that reads the neighbours through an
+ * hk_graph view, so that a table mapped straight from disk (see
+ * graph_file.h) can be labelled as is. Nodes may have any number of
+ * neighbours.
+ *
+ * INPUT:
+ * -g: the neighbour table.
+ * -occupancy: vector with the occupation number (0 or 1) of the nodes.
+ * OUTPUT:
+ * -node_labels: the labels of the nodes. Assumed that space already allocated.
+ */
+void extended_hk_graph(int* node_labels, const hk_graph& g,
+                       const int* occupancy) {
+  const int N = g.N;
+  for (int i = 0; i < N; ++i)
+    node_labels[i] = N+1;
+
+  // One label more than nodes, since labels[0] is the counter.
+  uf_initialize(N+1);
+
+  if (g.index_bytes == 2)
+    hk_graph_sweep(node_labels, g, (const unsigned short*)g.nbs, occupancy, 0);
+  else
+    hk_graph_sweep(node_labels, g, (const int*)g.nbs, occupancy, 0);
+
+  uf_canonicalise(node_labels, occupancy, N);
+  uf_done();
+}
+
+/* Labels the nodes [first, first+g.N) of a larger graph that has been split
+ * into subdomains, and summarises what hk_merge_summaries needs to join the
+ * subdomains later. Row i of g holds the neighbours of node first+i as global
+ * node indices, and the neighbour table of the whole graph must be symmetric.
+ *
+ * INPUT:
+ * -g: the rows of the neighbour table belonging to the subdomain.
+ * -occupancy: the occupation numbers of the nodes of the subdomain.
+ * -first: the global index of the first node of the subdomain.
+ * OUTPUT:
+ * -node_labels: the local labels of the nodes of the subdomain.
+ * -summary: the local cluster sizes and the bonds leaving the subdomain.
+ */
+void hk_label_subdomain(int* node_labels, const hk_graph& g,
+                        const int* occupancy, int first,
+                        hk_boundary_summary& summary) {
+  const int N = g.N;
+  for (int i = 0; i < N; ++i)
+    node_labels[i] = N+1;
+
+  uf_initialize(N+1);
+  if (g.index_bytes == 2)
+    hk_graph_sweep(node_labels, g, (const unsigned short*)g.nbs, occupancy,
+                   first);
+  else
+    hk_graph_sweep(node_labels, g, (const int*)g.nbs, occupancy, first);
+  uf_canonicalise(node_labels, occupancy, N);
+  uf_done();
+
+  summary.first = first;
+  summary.N = N;
+  summary.cluster_sizes.clear();
+  summary.boundary_nodes.clear();
+  summary.boundary_labels.clear();
+  summary.boundary_nbs.clear();
+
+  for (int i = 0; i < N; ++i) {
+    if (!occupancy[i])
+      continue;
+    const int c = node_labels[i];
+    if (c > (int)summary.cluster_sizes.size())
+      summary.cluster_sizes.push_back(0);
+    summary.cluster_sizes[c-1]++;
+
+    // Record the bonds leaving the subdomain.
+    long long begin = (g.degree > 0) ? (long long)i * g.degree : g.offsets[i];
+    long long end = (g.degree > 0) ? begin + g.degree : g.offsets[i+1];
+    for (long long j = begin; j < end; ++j) {
+      int nb;
+      if (g.index_bytes == 2) {
+        nb = ((const unsigned short*)g.nbs)[j];
+        if (nb == 0xFFFF)
+          continue;
       }
-      node_labels[i] = new_labels[x];
+      else
+        nb = ((const int*)g.nbs)[j];
+      if (nb == -1 || (unsigned int)(nb - first) < (unsigned int)N)
+        continue;
+      summary.boundary_nodes.push_back(first + i);
+      summary.boundary_labels.push_back(c);
+      summary.boundary_nbs.push_back(nb);
+    }
+  }
+}
+
+/* Joins the clusters of several subdomains labelled by hk_label_subdomain.
+ * When the summaries are sorted by 'first' and their nodes cover the graph,
+ * the global labels are exactly those that labelling the whole graph at once
+ * would give.
+ *
+ * INPUT:
+ * -summaries: the summaries of the subdomains.
+ * OUTPUT:
+ * -global_labels: global_labels[s][c-1] is the global label of local cluster c
+ *                 of summaries[s].
+ * -global_sizes: global_sizes[l-1] is the size of global cluster l.
+ */
+void hk_merge_summaries(const std::vector<hk_boundary_summary>& summaries,
+                        std::vector<std::vector<int> >& global_labels,
+                        std::vector<int>& global_sizes) {
+  const int n_domains = summaries.size();
+
+  // Local cluster c of summary s is merged cluster bases[s] + c.
+  std::vector<int> bases(n_domains + 1, 0);
+  for (int s = 0; s < n_domains; ++s)
+    bases[s+1] = bases[s] + summaries[s].cluster_sizes.size();
+  const int n_clusters = bases[n_domains];
+
+  uf_initialize(n_clusters + 1);
+  for (int c = 0; c < n_clusters; ++c)
+    uf_make_set();
+
+  // Look up the merged cluster of a boundary node by its global index.
+  std::vector<std::pair<int, int> > boundary;
+  for (int s = 0; s < n_domains; ++s)
+    for (size_t b = 0; b < summaries[s].boundary_nodes.size(); ++b)
+      boundary.push_back(std::make_pair(summaries[s].boundary_nodes[b],
+                                        bases[s] + summaries[s].boundary_labels[b]));
+  sort(boundary.begin(), boundary.end());
+
+  // Join the clusters on both ends of every bond between subdomains.
+  for (int s = 0; s < n_domains; ++s) {
+    const hk_boundary_summary& sum = summaries[s];
+    for (size_t b = 0; b < sum.boundary_nbs.size(); ++b) {
+      std::vector<std::pair<int, int> >::const_iterator nb =
+          lower_bound(boundary.begin(), boundary.end(),
+                      std::make_pair(sum.boundary_nbs[b], 0));
+      if (nb != boundary.end() && nb->first == sum.boundary_nbs[b])
+        uf_union(bases[s] + sum.boundary_labels[b], nb->second);
+    }
+  }
+
+  // Number the merged clusters in order of first occurrence.
+  std::vector<int> ids(n_clusters), all(n_clusters, 1);
+  for (int c = 0; c < n_clusters; ++c)
+    ids[c] = c + 1;
+  if (n_clusters > 0)
+    uf_canonicalise(&ids[0], &all[0], n_clusters);
+  uf_done();
+
+  global_labels.assign(n_domains, std::vector<int>());
+  global_sizes.clear();
+  for (int s = 0; s < n_domains; ++s) {
+    const std::vector<int>& sizes = summaries[s].cluster_sizes;
+    for (size_t c = 0; c < sizes.size(); ++c) {
+      const int l = ids[bases[s] + c];
+      global_labels[s].push_back(l);
+      if (l > (int)global_sizes.size())
+        global_sizes.resize(l, 0);
+      global_sizes[l-1] += sizes[c];
+    }
+  }
+}
+
+/* Join the clusters of two rows of a lattice wherever both are occupied at the
+ * same position. Sites in one run share a label, so uf_union is only called
+ * once per pair of overlapping runs.
+ */
+static void union_rows(int* node_labels, const int* occupancy,
+                       int row, int other_row, int L) {
+  int last_label = 0, last_other = 0;
+  for (int x = 0; x < L; ++x) {
+    if (occupancy[row + x] && occupancy[other_row + x]) {
+      int label = node_labels[row + x];
+      int other = node_labels[other_row + x];
+      if (label != last_label || other != last_other)
+        uf_union(label, other);
+      last_label = label;
+      last_other = other;
     }
-    else {
-      node_labels[i] = 0; // Replace placeholders with 0.
+    else
+      last_label = last_other = 0;
+  }
+}
+
+/* The sweep of extended_hk_lattice_runs. Returns the number of nodes. */
+
+static int lattice_runs_sweep(int* node_labels, const int* occupancy,
+                              const int* dims, int d, bool periodic) {
+  const int L = dims[0];
+  int N = 1;
+  for (int k = 0; k < d; ++k)
+    N *= dims[k];
+  const int n_rows = N / L;
+
+  // Strides of the row axes, and the coordinates of the current row.
+  std::vector<int> strides(d, L);
+  for (int k = 2; k < d; ++k)
+    strides[k] = strides[k-1] * dims[k-1];
+  std::vector<int> coords(d, 0);
+
+  uf_initialize(N+1);
+
+  for (int r = 0; r < n_rows; ++r) {
+    const int row = r * L;
+
+    // Give each run in the row a new label.
+    for (int x = 0; x < L; ) {
+      if (!occupancy[row + x]) {
+        ++x;
+        continue;
+      }
+      const int label = uf_make_set();
+      const int start = x;
+      for (; x < L && occupancy[row + x]; ++x)
+        node_labels[row + x] = label;
+      if (cluster_sizes)
+        cluster_sizes[label] = x - start;
     }
 
-  // Cleanup
-  delete[] new_labels;
+    // Merge with the previous row along each of the other axes.
+    for (int k = 1; k < d; ++k)
+      if (coords[k] > 0)
+        union_rows(node_labels, occupancy, row, row - strides[k], L);
+
+    // Periodic bonds within the row.
+    if (periodic && L > 1 && occupancy[row] && occupancy[row + L - 1])
+      uf_union(node_labels[row], node_labels[row + L - 1]);
+
+    // Periodic bonds from the last row back to the first along the other axes.
+    if (periodic)
+      for (int k = 1; k < d; ++k)
+        if (coords[k] == dims[k] - 1 && dims[k] > 1)
+          union_rows(node_labels, occupancy, row,
+                     row - (dims[k] - 1) * strides[k], L);
+
+    // Advance the row coordinates.
+    for (int k = 1; k < d && ++coords[k] == dims[k]; ++k)
+      coords[k] = 0;
+  }
+  return N;
+}
+
+/* A flavour of the HK algorithm for hypercubic lattices that works on runs of
+ * occupied sites along the fastest axis instead of single sites. Every run gets
+ * one label, and runs are only merged where they overlap with a run in the
+ * previous row along one of the other axes. This cuts the number of calls to
+ * uf_union by roughly the mean run length. The labels are identical to those of
+ * extended_hk_no_boost on the same lattice.
+ *
+ * INPUT:
+ * -occupancy: vector with the occupation number (0 or 1) of the nodes.
+ * -dims: the side lengths of the lattice. Node (x_0, ..., x_{d-1}) has index
+ *        x_0 + dims[0]*(x_1 + dims[1]*(x_2 + ...)).
+ * -d: the number of dimensions.
+ * -periodic: whether the lattice has periodic boundary conditions.
+ * OUTPUT:
+ * -node_labels: the labels of the nodes. Assumed that space already allocated.
+ */
+void extended_hk_lattice_runs(int* node_labels, const int* occupancy,
+                              const int* dims, int d, bool periodic) {
+  const int N = lattice_runs_sweep(node_labels, occupancy, dims, d, periodic);
+  uf_canonicalise(node_labels, occupancy, N);
+  uf_done();
+}
+
+/* Orders clusters by decreasing size, and those of equal size by first occurrence. */
+
+static bool larger_cluster(const pair<int, int>& a, const pair<int, int>& b) {
+  return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+/* Finds the k largest clusters without numbering all clusters. The sizes are
+ * kept at the roots of the union-find forest during the sweep, so only the
+ * roots have to be ranked at the end, and the nodes are only visited again if
+ * the members of the clusters are wanted.
+ *
+ * INPUT:
+ * -g: the neighbour table.
+ * -occupancy: vector with the occupation number (0 or 1) of the nodes.
+ * -k: the number of clusters wanted. k <= 0 gives no clusters.
+ * -members: whether to list the members of each cluster, as node indices
+ *           (MEMBER_LIST) or as one bit per node (MEMBER_BITSET).
+ * OUTPUT:
+ * -clusters: the (at most) k largest clusters by decreasing size. Clusters of
+ *            equal size come in order of first occurrence.
+ */
+void extended_hk_largest(const hk_graph& g, const int* occupancy, int k,
+                         hk_members members, std::vector<hk_cluster>& clusters) {
+  const int N = g.N;
+  int *node_labels = hk_alloc_ints(N);
+  for (int i = 0; i < N; ++i)
+    node_labels[i] = N+1;
+
+  uf_initialize(N+1);
+  cluster_sizes = hk_alloc_ints(N+1);
+  if (g.index_bytes == 2)
+    hk_graph_sweep(node_labels, g, (const unsigned short*)g.nbs, occupancy, 0);
+  else
+    hk_graph_sweep(node_labels, g, (const int*)g.nbs, occupancy, 0);
+
+  // Rank the roots by size.
+  std::vector<pair<int, int> > roots;
+  for (int x = 1; x <= labels[0]; ++x)
+    if (labels[x] == x)
+      roots.push_back(make_pair(cluster_sizes[x], x));
+  k = max(0, min(k, (int)roots.size()));
+  partial_sort(roots.begin(), roots.begin() + k, roots.end(), larger_cluster);
+
+  clusters.assign(k, hk_cluster());
+  std::vector<pair<int, int> > wanted; // (root, rank) sorted by root
+  for (int c = 0; c < k; ++c) {
+    clusters[c].size = roots[c].first;
+    wanted.push_back(make_pair(roots[c].second, c));
+    if (members == MEMBER_BITSET)
+      clusters[c].member_bits.assign(N, false);
+  }
+  sort(wanted.begin(), wanted.end());
+
+  if (members != NO_MEMBERS && k > 0)
+    for (int i = 0; i < N; ++i) {
+      if (!occupancy[i])
+        continue;
+      const int root = uf_find(node_labels[i]);
+      std::vector<pair<int, int> >::const_iterator it =
+          lower_bound(wanted.begin(), wanted.end(), make_pair(root, 0));
+      if (it == wanted.end() || it->first != root)
+        continue;
+      if (members == MEMBER_LIST)
+        clusters[it->second].members.push_back(i);
+      else
+        clusters[it->second].member_bits[i] = true;
+    }
+
+  hk_free_ints(cluster_sizes, N+1);
+  cluster_sizes = 0;
+  uf_done();
+  hk_free_ints(node_labels, N);
+}
+
+/* A flavour of extended_hk_graph that also measures the shape of every
+ * cluster. The sums of the coordinates and of their squares, and the bounding
+ * box, are kept at the roots and merged in uf_union, so they are ready as soon
+ * as the sweep is done.
+ *
+ * INPUT:
+ * -g: the neighbour table.
+ * -occupancy: vector with the occupation number (0 or 1) of the nodes.
+ * -coords: dim coordinates per node, e.g. from lattice_positions.
+ * -dim: the number of coordinates per node.
+ * OUTPUT:
+ * -node_labels: the labels of the nodes. Assumed that space already allocated.
+ * -clusters: clusters[l-1] describes the cluster labelled l.
+ */
+void extended_hk_geometry(int* node_labels, const hk_graph& g,
+                          const int* occupancy, const double* coords, int dim,
+                          std::vector<hk_cluster_geometry>& clusters) {
+  const int N = g.N;
+  for (int i = 0; i < N; ++i)
+    node_labels[i] = N+1;
+
+  uf_initialize(N+1);
+  cluster_sizes = hk_alloc_ints(N+1);
+  // Only read at labels made by uf_make_set, which clears them.
+  const size_t n_moments = (size_t)(N+1) * (3*dim + 1);
+  cluster_moments = hk_alloc_doubles(n_moments);
+  moment_dim = dim;
+
+  if (g.index_bytes == 2)
+    hk_graph_sweep(node_labels, g, (const unsigned short*)g.nbs, occupancy, 0,
+                   coords);
+  else
+    hk_graph_sweep(node_labels, g, (const int*)g.nbs, occupancy, 0, coords);
+
+  // The roots in label order are the clusters in canonical order.
+  clusters.clear();
+  for (int x = 1; x <= labels[0]; ++x) {
+    if (labels[x] != x)
+      continue;
+    const double* m = cluster_moments + (long long)x * (3*dim + 1);
+    hk_cluster_geometry c;
+    c.size = cluster_sizes[x];
+    double centre_sq = 0;
+    for (int k = 0; k < dim; ++k) {
+      c.centre.push_back(m[k] / c.size);
+      centre_sq += c.centre[k] * c.centre[k];
+    }
+    c.min.assign(m + dim + 1, m + 2*dim + 1);
+    c.max.assign(m + 2*dim + 1, m + 3*dim + 1);
+    c.radius_of_gyration = sqrt(max(0.0, m[dim] / c.size - centre_sq));
+    clusters.push_back(c);
+  }
+
+  uf_canonicalise(node_labels, occupancy, N);
+  hk_free_doubles(cluster_moments, n_moments);
+  cluster_moments = 0;
+  moment_dim = 0;
+  hk_free_ints(cluster_sizes, N+1);
+  cluster_sizes = 0;
+  uf_done();
+}
+
+/* Flavours of extended_hk_graph and extended_hk_lattice_runs that hand the
+ * labels to a writer (see label_output.h) instead of returning them. The
+ * labels are written block by block while they are relabelled, and only the
+ * labeler's own scratch array of N ints is ever held.
+ *
+ * INPUT:
+ * -g, or occupancy, dims, d and periodic: as for the labelers.
+ * OUTPUT:
+ * -writer: receives the number of clusters, their sizes and then the labels
+ *          in node order. Returns false if the writer fails.
+ */
+bool extended_hk_write(const hk_graph& g, const int* occupancy,
+                       hk_label_writer& writer) {
+  const int N = g.N;
+  int *node_labels = hk_alloc_ints(N);
+  for (int i = 0; i < N; ++i)
+    node_labels[i] = N+1;
+
+  uf_initialize(N+1);
+  cluster_sizes = hk_alloc_ints(N+1);
+  if (g.index_bytes == 2)
+    hk_graph_sweep(node_labels, g, (const unsigned short*)g.nbs, occupancy, 0);
+  else
+    hk_graph_sweep(node_labels, g, (const int*)g.nbs, occupancy, 0);
+  bool ok = uf_canonicalise(node_labels, occupancy, N, &writer);
+
+  hk_free_ints(cluster_sizes, N+1);
+  cluster_sizes = 0;
+  uf_done();
+  hk_free_ints(node_labels, N);
+  return ok;
+}
+
+bool extended_hk_lattice_runs_write(const int* occupancy, const int* dims,
+                                    int d, bool periodic,
+                                    hk_label_writer& writer) {
+  int N = 1;
+  for (int k = 0; k < d; ++k)
+    N *= dims[k];
+  int *node_labels = hk_alloc_ints(N);
+
+  cluster_sizes = hk_alloc_ints(N+1);
+  lattice_runs_sweep(node_labels, occupancy, dims, d, periodic);
+  bool ok = uf_canonicalise(node_labels, occupancy, N, &writer);
+
+  hk_free_ints(cluster_sizes, N+1);
+  cluster_sizes = 0;
   uf_done();
+  hk_free_ints(node_labels, N);
+  return ok;
 }
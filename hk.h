@@ -2,6 +2,7 @@
 #define HK_H_
 
 #include <boost/multi_array.hpp>
+#include <vector>
 
 void extended_hoshen_kopelman(boost::multi_array<int, 1>& node_labels,
                               const boost::multi_array<int, 2>& nbs,
@@ -10,4 +11,99 @@ void extended_hoshen_kopelman(boost::multi_array<int, 1>& node_labels,
 void extended_hk_no_boost(int* node_labels, int const* const* nbs,
                           const int* occupancy, int N, int m);
 
+/* A read-only view of a neighbour table that extended_hk_graph can label
+ * without copying it.
+ * -degree > 0: nbs holds N rows of 'degree' entries. Unused entries are -1.
+ * -degree == 0: the neighbours of node i are nbs[offsets[i]..offsets[i+1]).
+ * -index_bytes: 4 if nbs is an int array, 2 if it is an unsigned short array
+ *  (N < 65535, unused entries are 0xFFFF).
+ */
+struct hk_graph {
+  int N;
+  int degree;
+  const long long* offsets;
+  const void* nbs;
+  int index_bytes;
+};
+
+void extended_hk_graph(int* node_labels, const hk_graph& g,
+                       const int* occupancy);
+
+/* What is left of a subdomain after labelling it with hk_label_subdomain:
+ * -first, N: the subdomain holds the nodes [first, first+N).
+ * -cluster_sizes: cluster_sizes[c-1] is the size of local cluster c.
+ * -boundary_nodes, boundary_labels, boundary_nbs: one entry per bond from an
+ *  occupied node of the subdomain to a node outside it, giving the global
+ *  index of the inside node, its local cluster and the global index of the
+ *  outside node.
+ */
+struct hk_boundary_summary {
+  int first;
+  int N;
+  std::vector<int> cluster_sizes;
+  std::vector<int> boundary_nodes;
+  std::vector<int> boundary_labels;
+  std::vector<int> boundary_nbs;
+};
+
+void hk_label_subdomain(int* node_labels, const hk_graph& g,
+                        const int* occupancy, int first,
+                        hk_boundary_summary& summary);
+
+void hk_merge_summaries(const std::vector<hk_boundary_summary>& summaries,
+                        std::vector<std::vector<int> >& global_labels,
+                        std::vector<int>& global_sizes);
+
+/* Which members of its clusters extended_hk_largest should return. */
+enum hk_members { NO_MEMBERS, MEMBER_LIST, MEMBER_BITSET };
+
+/* One of the clusters found by extended_hk_largest. */
+struct hk_cluster {
+  int size;
+  std::vector<int> members;      // MEMBER_LIST: the nodes in increasing order
+  std::vector<bool> member_bits; // MEMBER_BITSET: member_bits[i] if i belongs
+};
+
+void extended_hk_largest(const hk_graph& g, const int* occupancy, int k,
+                         hk_members members, std::vector<hk_cluster>& clusters);
+
+/* The shape of one cluster, as found by extended_hk_geometry. */
+struct hk_cluster_geometry {
+  int size;
+  std::vector<double> centre;  // centre of mass
+  std::vector<double> min;     // bounding box
+  std::vector<double> max;
+  double radius_of_gyration;
+};
+
+void extended_hk_geometry(int* node_labels, const hk_graph& g,
+                          const int* occupancy, const double* coords, int dim,
+                          std::vector<hk_cluster_geometry>& clusters);
+
+void extended_hk_lattice_runs(int* node_labels, const int* occupancy,
+                              const int* dims, int d, bool periodic);
+
+/* Receives the labels from extended_hk_write in node order, a block at a
+ * time. See label_output.h for writers of compact files.
+ * -begin: called once with the number of nodes and clusters, and the cluster
+ *  sizes (sizes[l-1] for label l) if the labeler counted them.
+ * -write: the labels of the nodes [first, first+count).
+ * -finish: called after the last block.
+ * Each returns false on failure, which stops the labeler.
+ */
+class hk_label_writer {
+ public:
+  virtual ~hk_label_writer() {}
+  virtual bool begin(int N, int n_clusters, const int* sizes) = 0;
+  virtual bool write(const int* labels, int first, int count) = 0;
+  virtual bool finish() = 0;
+};
+
+bool extended_hk_write(const hk_graph& g, const int* occupancy,
+                       hk_label_writer& writer);
+
+bool extended_hk_lattice_runs_write(const int* occupancy, const int* dims,
+                                    int d, bool periodic,
+                                    hk_label_writer& writer);
+
 #endif /* HK_H_ */
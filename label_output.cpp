@@ -0,0 +1,184 @@
+/* Compact label files written while the labels are relabelled. See
+ label_output.h for the layouts. */
+
+#include "label_output.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+/* Write the header shared by all label files. */
+
+static bool write_header(FILE* f, const char* magic, int N, int n_clusters) {
+  const long long counts[2] = {N, n_clusters};
+  return fwrite(magic, 1, 8, f) == 8 && fwrite(counts, 8, 2, f) == 2;
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ * Fixed width
+ * ---------------------------------------------------------------------------
+ */
+
+fixed_width_writer::fixed_width_writer(const char* path)
+    : file_(fopen(path, "wb")), bits_(0), word_(0), word_bits_(0) {}
+
+fixed_width_writer::~fixed_width_writer() {
+  if (file_)
+    fclose(file_);
+}
+
+bool fixed_width_writer::begin(int N, int n_clusters, const int*) {
+  bits_ = 1;
+  while (bits_ < 32 && (n_clusters >> bits_) != 0)
+    bits_++;
+  const long long width = bits_;
+  return file_ && write_header(file_, "HKLABFW1", N, n_clusters)
+         && fwrite(&width, 8, 1, file_) == 1;
+}
+
+bool fixed_width_writer::write(const int* labels, int, int count) {
+  buffer_.clear();
+  for (int i = 0; i < count; ++i) {
+    const unsigned long long label = (unsigned int)labels[i];
+    word_ |= label << word_bits_;
+    word_bits_ += bits_;
+    if (word_bits_ >= 64) {
+      buffer_.push_back(word_);
+      word_bits_ -= 64;
+      word_ = word_bits_ ? label >> (bits_ - word_bits_) : 0;
+    }
+  }
+  return buffer_.empty()
+         || fwrite(&buffer_[0], 8, buffer_.size(), file_) == buffer_.size();
+}
+
+bool fixed_width_writer::finish() {
+  bool ok = !word_bits_ || fwrite(&word_, 8, 1, file_) == 1;
+  ok = (fclose(file_) == 0) && ok;
+  file_ = 0;
+  return ok;
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ * Run length
+ * ---------------------------------------------------------------------------
+ */
+
+run_length_writer::run_length_writer(const char* path)
+    : file_(fopen(path, "wb")), label_(0), length_(0) {}
+
+run_length_writer::~run_length_writer() {
+  if (file_)
+    fclose(file_);
+}
+
+bool run_length_writer::begin(int N, int n_clusters, const int*) {
+  label_ = 0;
+  length_ = 0;
+  return file_ && write_header(file_, "HKLABRL1", N, n_clusters);
+}
+
+static void put_varint(vector<unsigned char>& buf, unsigned long long v) {
+  while (v >= 0x80) {
+    buf.push_back((unsigned char)(v | 0x80));
+    v >>= 7;
+  }
+  buf.push_back((unsigned char)v);
+}
+
+void run_length_writer::put_run() {
+  if (length_ > 0) {
+    put_varint(buffer_, label_);
+    put_varint(buffer_, length_);
+  }
+}
+
+bool run_length_writer::write(const int* labels, int, int count) {
+  // A run may continue from the previous block, so it is only written once
+  // a different label turns up.
+  buffer_.clear();
+  for (int i = 0; i < count; ++i) {
+    if (labels[i] != label_ || length_ == 0) {
+      put_run();
+      label_ = labels[i];
+      length_ = 0;
+    }
+    length_++;
+  }
+  return buffer_.empty()
+         || fwrite(&buffer_[0], 1, buffer_.size(), file_) == buffer_.size();
+}
+
+bool run_length_writer::finish() {
+  buffer_.clear();
+  put_run();
+  bool ok = buffer_.empty()
+            || fwrite(&buffer_[0], 1, buffer_.size(), file_) == buffer_.size();
+  ok = (fclose(file_) == 0) && ok;
+  file_ = 0;
+  return ok;
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ * Cluster member lists
+ * ---------------------------------------------------------------------------
+ */
+
+cluster_list_writer::cluster_list_writer(const char* path)
+    : path_(path), map_(MAP_FAILED), length_(0), members_(0) {}
+
+cluster_list_writer::~cluster_list_writer() {
+  if (map_ != MAP_FAILED)
+    munmap(map_, length_);
+}
+
+bool cluster_list_writer::begin(int N, int n_clusters, const int* sizes) {
+  if (!sizes && n_clusters > 0)
+    return false;
+
+  // Where the members of each cluster go.
+  next_.assign(n_clusters + 1, 0);
+  for (int c = 0; c < n_clusters; ++c)
+    next_[c+1] = next_[c] + sizes[c];
+  const size_t header = 8 + 2*8 + (n_clusters + 1) * 8;
+  length_ = header + next_[n_clusters] * 4;
+
+  int fd = open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+  if (ftruncate(fd, length_) != 0) {
+    close(fd);
+    return false;
+  }
+  map_ = mmap(0, length_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map_ == MAP_FAILED)
+    return false;
+
+  char* p = (char*)map_;
+  const long long counts[2] = {N, n_clusters};
+  memcpy(p, "HKLABCL1", 8);
+  memcpy(p + 8, counts, sizeof(counts));
+  memcpy(p + 24, &next_[0], (n_clusters + 1) * 8);
+  members_ = (int*)(p + header);
+  return true;
+}
+
+bool cluster_list_writer::write(const int* labels, int first, int count) {
+  for (int i = 0; i < count; ++i)
+    if (labels[i])
+      members_[next_[labels[i] - 1]++] = first + i;
+  return true;
+}
+
+bool cluster_list_writer::finish() {
+  bool ok = msync(map_, length_, MS_SYNC) == 0;
+  ok = (munmap(map_, length_) == 0) && ok;
+  map_ = MAP_FAILED;
+  return ok;
+}
@@ -0,0 +1,79 @@
+#ifndef LABEL_OUTPUT_H_
+#define LABEL_OUTPUT_H_
+
+#include "hk.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/* Writers of compact label files for extended_hk_write and
+ * extended_hk_lattice_runs_write. Every file starts with an 8 byte magic, the
+ * number of nodes and the number of clusters (8 bytes each). Integers are
+ * stored in host byte order.
+ */
+
+/* "HKLABFW1": every label in the narrowest width that holds the number of
+ * clusters. After the header comes the width in bits (8 bytes), then from
+ * byte 32 on the labels packed into 8 byte words starting at the lowest bit,
+ * so the words are aligned in a mapped file.
+ */
+class fixed_width_writer : public hk_label_writer {
+ public:
+  explicit fixed_width_writer(const char* path);
+  ~fixed_width_writer();
+  bool begin(int N, int n_clusters, const int* sizes);
+  bool write(const int* labels, int first, int count);
+  bool finish();
+
+ private:
+  FILE* file_;
+  int bits_;
+  unsigned long long word_;
+  int word_bits_;
+  std::vector<unsigned long long> buffer_;
+};
+
+/* "HKLABRL1": the labels in node order as runs, each run a pair of LEB128
+ * varints (label, length). On lattices most runs are whole runs of occupied
+ * or empty sites along the first axis.
+ */
+class run_length_writer : public hk_label_writer {
+ public:
+  explicit run_length_writer(const char* path);
+  ~run_length_writer();
+  bool begin(int N, int n_clusters, const int* sizes);
+  bool write(const int* labels, int first, int count);
+  bool finish();
+
+ private:
+  void put_run();
+
+  FILE* file_;
+  int label_;
+  long long length_;
+  std::vector<unsigned char> buffer_;
+};
+
+/* "HKLABCL1": the members of every cluster. After the header come
+ * n_clusters+1 offsets (8 bytes each) and then the members as 4 byte node
+ * indices, those of label l at [offsets[l-1], offsets[l]) in increasing order.
+ * Empty nodes are left out. The file is mapped into memory and the members
+ * are scattered into it as the blocks arrive, so it needs the cluster sizes.
+ */
+class cluster_list_writer : public hk_label_writer {
+ public:
+  explicit cluster_list_writer(const char* path);
+  ~cluster_list_writer();
+  bool begin(int N, int n_clusters, const int* sizes);
+  bool write(const int* labels, int first, int count);
+  bool finish();
+
+ private:
+  std::string path_;
+  void* map_;
+  size_t length_;
+  int* members_;
+  std::vector<long long> next_;
+};
+
+#endif /* LABEL_OUTPUT_H_ */
@@ -0,0 +1,120 @@
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* A bounded first-in first-out queue of buffer indices shared by two stages
+ * of run_pipeline. pop blocks until an index is available.
+ */
+class slot_queue {
+ public:
+  explicit slot_queue(int capacity)
+      : slots_(capacity), head_(0), size_(0) {}
+
+  void push(int slot) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    slots_[(head_ + size_) % slots_.size()] = slot;
+    size_++;
+    ready_.notify_one();
+  }
+
+  int pop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (size_ == 0)
+      ready_.wait(lock);
+    int slot = slots_[head_];
+    head_ = (head_ + 1) % slots_.size();
+    size_--;
+    return slot;
+  }
+
+ private:
+  std::vector<int> slots_;
+  int head_;
+  int size_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+};
+
+/* Runs the realizations first, ..., first+n-1 of an ensemble through three
+ * stages that overlap: while realization k is labelled on one thread, the
+ * occupancy of k+1 is generated on another and realization k-1 is measured
+ * on the calling thread. Each stage sees the realizations in order, so a
+ * single MTRand in 'fill' gives the same ensemble as a sequential loop.
+ *
+ * Needs C++11 threads (-std=c++11 -pthread).
+ *
+ * The buffers are allocated once and recycled, 'depth' pairs of occupancy
+ * and label arrays of N ints each. depth >= 3 lets all stages run at once.
+ *
+ * INPUT:
+ * -fill(int* occupancy, long k): fill the occupancy of realization k.
+ * -label(int* node_labels, const int* occupancy, long k): label it, e.g.
+ *  with extended_hk_graph. Only one realization is labelled at a time, as
+ *  the labelers share their union-find state.
+ * -measure(const int* node_labels, const int* occupancy, long k): compute
+ *  the observables of realization k.
+ * -checkpoint(long k): called on the calling thread every checkpoint_every
+ *  realizations, when all realizations before k have been measured and the
+ *  occupancy of k has not been generated yet. The state of the generators in
+ *  'fill' then belongs exactly to realization k, so a checkpoint written here
+ *  (see checkpoint.h) can resume the run with first = k.
+ */
+template <typename Fill, typename Label, typename Measure, typename Checkpoint>
+void run_pipeline(long first, long n, int N, int depth,
+                  Fill fill, Label label, Measure measure,
+                  long checkpoint_every, Checkpoint checkpoint) {
+  std::vector<int> occupancy((size_t)depth * N);
+  std::vector<int> node_labels((size_t)depth * N);
+  slot_queue empty(depth), filled(depth), labelled(depth), resume(1);
+  for (int s = 0; s < depth; ++s)
+    empty.push(s);
+
+  std::thread filler([&]() {
+    for (long k = first; k < first + n; ++k) {
+      // Wait for the checkpoint before generating past it.
+      if (checkpoint_every > 0 && k > first && (k - first) % checkpoint_every == 0)
+        resume.pop();
+      int s = empty.pop();
+      fill(&occupancy[(size_t)s * N], k);
+      filled.push(s);
+    }
+  });
+
+  std::thread labeller([&]() {
+    for (long k = first; k < first + n; ++k) {
+      int s = filled.pop();
+      label(&node_labels[(size_t)s * N], &occupancy[(size_t)s * N], k);
+      labelled.push(s);
+    }
+  });
+
+  for (long k = first; k < first + n; ++k) {
+    int s = labelled.pop();
+    measure(&node_labels[(size_t)s * N], &occupancy[(size_t)s * N], k);
+    empty.push(s);
+    if (checkpoint_every > 0 && k + 1 < first + n
+        && (k + 1 - first) % checkpoint_every == 0) {
+      checkpoint(k + 1);
+      resume.push(0);
+    }
+  }
+
+  filler.join();
+  labeller.join();
+}
+
+struct no_checkpoint {
+  void operator()(long) const {}
+};
+
+template <typename Fill, typename Label, typename Measure>
+void run_pipeline(long first, long n, int N, int depth,
+                  Fill fill, Label label, Measure measure) {
+  run_pipeline(first, n, N, depth, fill, label, measure, 0, no_checkpoint());
+}
+
+#endif /* PIPELINE_H_ */
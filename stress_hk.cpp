@@ -0,0 +1,901 @@
+/* Differential stress test and performance regression check for the labelers.
+ *
+ * Every labeler is run on randomised graphs and compared with a plain
+ * breadth-first search, which numbers the clusters in order of first
+ * occurrence. The labels must agree exactly, which implies the same partition
+ * and the same canonical order, and the cluster sizes must agree as well.
+ *
+ * Each labeler is also timed on one graph of every size at a fixed p, taking
+ * the best of 'trials' runs. It fails if its time per node grows more than
+ * linearly with N, or if its throughput on the largest graph of a family is
+ * below the baseline file by more than the tolerance. If the baseline file
+ * does not exist (or 'update' is given) the measured throughputs are written
+ * to it.
+ *
+ * Usage: stress_hk <max_N> <trials> <baseline_file> [tolerance] [update]
+ *  e.g.  g++ -O2 -fopenmp stress_hk.cpp hk.cpp allocator.cpp generators.cpp
+ *            graph_file.cpp label_output.cpp -o stress_hk
+ *        ./stress_hk 100000000 3 baseline.txt 0.2
+ */
+
+#include "hk.h"
+#include "generators.h"
+#include "graph_file.h"
+#include "label_output.h"
+#include "MersenneTwister.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ * ---------------------------------------------------------------------------
+ * Test graphs
+ * ---------------------------------------------------------------------------
+ */
+
+/* A symmetric neighbour table (see generators.h) with the name of its family.
+ * Hypercubic lattices also carry their side lengths for
+ * extended_hk_lattice_runs, and the other lattices the positions of their
+ * nodes from lattice_positions.
+ */
+struct test_graph : owned_graph {
+  string family;
+  vector<int> dims;
+  bool periodic;
+  vector<double> coords;
+};
+
+/* A d-dimensional hypercubic lattice with side L. With open boundaries the
+ * rows of the boundary sites are padded with -1.
+ */
+static test_graph hypercubic(const string& family, int d, int L, bool periodic) {
+  test_graph g;
+  g.family = family;
+  g.dims.assign(d, L);
+  g.periodic = periodic;
+  lattice_graph(g, HYPERCUBIC, &g.dims[0], d, periodic);
+  return g;
+}
+
+/* A random 3-regular graph from the configuration model. Self-loops and
+ * multiple edges are kept.
+ */
+static test_graph random_regular(int N, MTRand& rng) {
+  test_graph g;
+  g.family = "random_regular";
+  g.periodic = false;
+  random_regular_graph(g, N + (N % 2), 3, rng.randInt());
+  return g;
+}
+
+/* A lattice from lattice_graph with about N nodes, at least 3 cells on a
+ * side, with open or periodic boundaries at random.
+ */
+static test_graph bravais(const string& family, lattice_type type, int d,
+                          int basis, long long N, MTRand& rng) {
+  test_graph g;
+  g.family = family;
+  g.periodic = rng.randInt(1);
+  const int L = max(3, (int)llround(pow((double)N / basis, 1.0 / d)));
+  const vector<int> dims(d, L);
+  lattice_graph(g, type, &dims[0], d, g.periodic);
+  lattice_positions(g.coords, type, &dims[0], d);
+  return g;
+}
+
+/* An Erdos-Renyi graph with mean degree 3. */
+
+static test_graph erdos_renyi(int N, MTRand& rng) {
+  test_graph g;
+  g.family = "erdos_renyi";
+  g.periodic = false;
+  erdos_renyi_graph(g, N, 3.0 / N, rng.randInt());
+  return g;
+}
+
+/* A small-world ring of degree 4 with a tenth of the bonds rewired. */
+
+static test_graph small_world(int N, MTRand& rng) {
+  test_graph g;
+  g.family = "small_world";
+  g.periodic = false;
+  small_world_graph(g, max(N, 5), 4, 0.1, rng.randInt());
+  return g;
+}
+
+/* A Barabasi-Albert scale-free graph where every new node attaches to two
+ * existing nodes chosen in proportion to their degree.
+ */
+static test_graph scale_free(int N, MTRand& rng) {
+  test_graph g;
+  g.family = "scale_free";
+  g.N = max(N, 3);
+  g.periodic = false;
+  vector<pair<int, int> > edges;
+  edges.push_back(make_pair(0, 1));
+  edges.push_back(make_pair(1, 2));
+  edges.push_back(make_pair(2, 0));
+  for (int i = 3; i < g.N; ++i)
+    for (int k = 0; k < 2; ++k) {
+      const pair<int, int>& e = edges[rng.randInt(edges.size() - 1)];
+      edges.push_back(make_pair(i, rng.randInt(1) ? e.first : e.second));
+    }
+  edge_list_graph(g, g.N, edges);
+  return g;
+}
+
+/* A square lattice whose nodes are numbered in a random order, so that HK
+ * sees no spatial locality at all.
+ */
+static test_graph permuted_square(int L, MTRand& rng) {
+  test_graph sq = hypercubic("permuted_square", 2, L, true);
+  vector<int> perm(sq.N);
+  for (int i = 0; i < sq.N; ++i)
+    perm[i] = i;
+  for (int i = sq.N - 1; i > 0; --i)
+    swap(perm[i], perm[rng.randInt(i)]);
+
+  test_graph g = sq;
+  g.dims.clear();
+  for (int i = 0; i < sq.N; ++i)
+    for (int j = 0; j < sq.degree; ++j)
+      g.nbs[(long long)perm[i] * g.degree + j] = perm[sq.nbs[(long long)i * sq.degree + j]];
+  return g;
+}
+
+/* An open path whose sites at even positions are numbered first, from the
+ * right end, and then those at odd positions from the left end. At p=1 every
+ * odd site joins the cluster on its left to a new root with a smaller label,
+ * which builds a chain of provisional labels as long as the path. The ends
+ * are their own neighbours so that every row is full.
+ */
+static test_graph zigzag_path(int N) {
+  test_graph g;
+  g.family = "zigzag_path";
+  g.N = max(N, 3);
+  g.degree = 2;
+  g.periodic = false;
+  const int n_even = (g.N + 1) / 2;
+  vector<int> index(g.N);
+  for (int k = 0; k < g.N; k += 2)
+    index[k] = n_even - 1 - k/2;
+  for (int k = 1; k < g.N; k += 2)
+    index[k] = n_even + k/2;
+  g.nbs.resize(2*g.N);
+  for (int k = 0; k < g.N; ++k) {
+    g.nbs[2*index[k]] = index[max(k-1, 0)];
+    g.nbs[2*index[k]+1] = index[min(k+1, g.N-1)];
+  }
+  return g;
+}
+
+/* The corner case from http://www.sciencedirect.com/science/article/pii/S0378437105008654#
+ * (see test_hk.cpp).
+ */
+static test_graph corner_case() {
+  test_graph g;
+  g.family = "corner_case";
+  g.N = 7;
+  g.degree = 2;
+  g.periodic = false;
+  const int nbs[14] = {6,-1, 5,-1, 4,5, 6,4, 3,2, 2,1, 0,3};
+  g.nbs.assign(nbs, nbs + 14);
+  return g;
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ * Reference and labelers under test
+ * ---------------------------------------------------------------------------
+ */
+
+/* Label the clusters by breadth-first search in order of first occurrence. */
+
+static void bfs_labels(const test_graph& g, const int* occupancy,
+                       vector<int>& labels) {
+  labels.assign(g.N, 0);
+  vector<int> queue;
+  int n_clusters = 0;
+  for (int s = 0; s < g.N; ++s) {
+    if (!occupancy[s] || labels[s])
+      continue;
+    labels[s] = ++n_clusters;
+    queue.assign(1, s);
+    for (size_t q = 0; q < queue.size(); ++q) {
+      const int i = queue[q];
+      long long begin = g.degree ? (long long)i * g.degree : g.offsets[i];
+      long long end = g.degree ? begin + g.degree : g.offsets[i+1];
+      for (long long j = begin; j < end; ++j) {
+        const int nb = g.nbs[j];
+        if (nb != -1 && occupancy[nb] && !labels[nb]) {
+          labels[nb] = n_clusters;
+          queue.push_back(nb);
+        }
+      }
+    }
+  }
+}
+
+static void cluster_sizes(const vector<int>& labels, vector<int>& sizes) {
+  sizes.clear();
+  for (size_t i = 0; i < labels.size(); ++i)
+    if (labels[i]) {
+      if (labels[i] > (int)sizes.size())
+        sizes.resize(labels[i], 0);
+      sizes[labels[i]-1]++;
+    }
+}
+
+typedef chrono::steady_clock wall_clock;
+
+static double seconds_since(wall_clock::time_point start) {
+  return chrono::duration<double>(wall_clock::now() - start).count();
+}
+
+/* A labeler under test. 'run' returns the labels, the cluster sizes if the
+ * labeler computes them itself, and the time spent labelling.
+ */
+struct engine {
+  const char* name;
+  bool (*applies)(const test_graph& g);
+  double (*run)(const test_graph& g, const int* occupancy,
+                vector<int>& labels, vector<int>& sizes);
+};
+
+static bool fixed_degree(const test_graph& g) {
+  return g.degree > 0
+      && find(g.nbs.begin(), g.nbs.end(), -1) == g.nbs.end();
+}
+
+static bool padded_table(const test_graph& g) {
+  if (g.degree == 0)
+    return false;
+  for (int i = 0; i < g.N; ++i)
+    if (g.nbs[(long long)i * g.degree] == -1)
+      return false;
+  return true;
+}
+
+static bool any_graph(const test_graph&) {
+  return true;
+}
+
+static bool lattice(const test_graph& g) {
+  return !g.dims.empty();
+}
+
+static double run_boost(const test_graph& g, const int* occupancy,
+                        vector<int>& labels, vector<int>&) {
+  boost::multi_array<int, 2> nbs(boost::extents[g.N][g.degree]);
+  copy(g.nbs.begin(), g.nbs.end(), nbs.data());
+  boost::multi_array<int, 1> occ(boost::extents[g.N]);
+  copy(occupancy, occupancy + g.N, occ.data());
+  boost::multi_array<int, 1> node_labels;
+
+  wall_clock::time_point start = wall_clock::now();
+  extended_hoshen_kopelman(node_labels, nbs, occ);
+  double t = seconds_since(start);
+
+  labels.assign(node_labels.data(), node_labels.data() + g.N);
+  return t;
+}
+
+static double run_no_boost(const test_graph& g, const int* occupancy,
+                           vector<int>& labels, vector<int>&) {
+  vector<const int*> rows(g.N);
+  for (int i = 0; i < g.N; ++i)
+    rows[i] = &g.nbs[(long long)i * g.degree];
+  labels.resize(g.N);
+
+  wall_clock::time_point start = wall_clock::now();
+  extended_hk_no_boost(&labels[0], &rows[0], occupancy, g.N, g.degree);
+  return seconds_since(start);
+}
+
+static double run_graph(const test_graph& g, const int* occupancy,
+                        vector<int>& labels, vector<int>&) {
+  labels.resize(g.N);
+  wall_clock::time_point start = wall_clock::now();
+  extended_hk_graph(&labels[0], g.view(), occupancy);
+  return seconds_since(start);
+}
+
+static double run_lattice_runs(const test_graph& g, const int* occupancy,
+                               vector<int>& labels, vector<int>&) {
+  labels.resize(g.N);
+  wall_clock::time_point start = wall_clock::now();
+  extended_hk_lattice_runs(&labels[0], occupancy, &g.dims[0], g.dims.size(),
+                           g.periodic);
+  return seconds_since(start);
+}
+
+/* Label four subdomains separately and merge them. */
+
+static double run_subdomains(const test_graph& g, const int* occupancy,
+                             vector<int>& labels, vector<int>& sizes) {
+  const int n_domains = 4;
+  vector<hk_boundary_summary> summaries(n_domains);
+  vector<int> bounds(n_domains + 1);
+  for (int d = 0; d <= n_domains; ++d)
+    bounds[d] = (long long)g.N * d / n_domains;
+  labels.resize(g.N);
+
+  wall_clock::time_point start = wall_clock::now();
+  for (int d = 0; d < n_domains; ++d) {
+    hk_graph h = g.view();
+    h.N = bounds[d+1] - bounds[d];
+    if (g.degree > 0)
+      h.nbs = &g.nbs[0] + (long long)bounds[d] * g.degree;
+    else
+      h.offsets = &g.offsets[0] + bounds[d];
+    hk_label_subdomain(&labels[bounds[d]], h, occupancy + bounds[d],
+                       bounds[d], summaries[d]);
+  }
+  vector<vector<int> > global_labels;
+  hk_merge_summaries(summaries, global_labels, sizes);
+  for (int d = 0; d < n_domains; ++d)
+    for (int i = bounds[d]; i < bounds[d+1]; ++i)
+      if (labels[i])
+        labels[i] = global_labels[d][labels[i]-1];
+  return seconds_since(start);
+}
+
+/* Find all clusters with extended_hk_largest and number them again by their
+ * first member. The clusters must come by decreasing size and then by first
+ * occurrence, otherwise no labels are returned.
+ */
+static double run_largest(const test_graph& g, const int* occupancy,
+                          vector<int>& labels, vector<int>& sizes) {
+  vector<hk_cluster> clusters;
+  wall_clock::time_point start = wall_clock::now();
+  extended_hk_largest(g.view(), occupancy, g.N, MEMBER_LIST, clusters);
+  double t = seconds_since(start);
+
+  vector<pair<int, int> > firsts; // (first member, cluster)
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    if (c > 0 && (clusters[c].size > clusters[c-1].size
+                  || (clusters[c].size == clusters[c-1].size
+                      && clusters[c].members[0] < clusters[c-1].members[0]))) {
+      labels.clear();
+      return t;
+    }
+    firsts.push_back(make_pair(clusters[c].members[0], c));
+  }
+  sort(firsts.begin(), firsts.end());
+
+  labels.assign(g.N, 0);
+  sizes.clear();
+  for (size_t l = 0; l < firsts.size(); ++l) {
+    const hk_cluster& c = clusters[firsts[l].second];
+    for (size_t m = 0; m < c.members.size(); ++m)
+      labels[c.members[m]] = l + 1;
+    sizes.push_back(c.size);
+  }
+  return t;
+}
+
+/* Label with extended_hk_geometry, using the lattice positions if the graph
+ * has them and the coordinates (i, i mod 7) for node i otherwise, and check
+ * its cluster shapes against a second pass over the labels. No labels are
+ * returned if they disagree.
+ */
+static double run_geometry(const test_graph& g, const int* occupancy,
+                           vector<int>& labels, vector<int>& sizes) {
+  vector<double> coords(g.coords);
+  if (coords.empty()) {
+    coords.resize(2*g.N);
+    for (int i = 0; i < g.N; ++i) {
+      coords[2*i] = i;
+      coords[2*i+1] = i % 7;
+    }
+  }
+  const int dim = coords.size() / max(g.N, 1);
+  vector<hk_cluster_geometry> clusters;
+  labels.resize(g.N);
+  wall_clock::time_point start = wall_clock::now();
+  extended_hk_geometry(&labels[0], g.view(), occupancy, &coords[0], dim,
+                       clusters);
+  double t = seconds_since(start);
+
+  // Sums, squares and bounding boxes straight from the labels.
+  const size_t n = clusters.size();
+  vector<double> sum(dim*n, 0), sum_sq(n, 0);
+  vector<double> lo(dim*n, HUGE_VAL), hi(dim*n, -HUGE_VAL);
+  vector<int> count(n, 0);
+  bool ok = true;
+  for (int i = 0; i < g.N; ++i) {
+    const int c = labels[i] - 1;
+    if (c < 0)
+      continue;
+    if (c >= (int)n) {
+      ok = false;
+      break;
+    }
+    count[c]++;
+    for (int k = 0; k < dim; ++k) {
+      const double x = coords[(long long)dim*i + k];
+      sum[dim*c+k] += x;
+      sum_sq[c] += x * x;
+      lo[dim*c+k] = min(lo[dim*c+k], x);
+      hi[dim*c+k] = max(hi[dim*c+k], x);
+    }
+  }
+  for (size_t c = 0; ok && c < n; ++c) {
+    const hk_cluster_geometry& cl = clusters[c];
+    double centre_sq = 0;
+    for (int k = 0; k < dim; ++k) {
+      const double centre = sum[dim*c+k] / count[c];
+      centre_sq += centre * centre;
+      ok = ok && fabs(cl.centre[k] - centre) <= 1e-9 * (1 + fabs(centre))
+              && cl.min[k] == lo[dim*c+k] && cl.max[k] == hi[dim*c+k];
+    }
+    const double rg = sqrt(max(0.0, sum_sq[c] / count[c] - centre_sq));
+    ok = ok && cl.size == count[c]
+            && fabs(cl.radius_of_gyration - rg) <= 1e-6 * (1 + rg);
+    sizes.push_back(cl.size);
+  }
+  if (!ok)
+    labels.clear();
+  return t;
+}
+
+/* A file for the file-based engines, unique to this process. */
+
+static string temp_path(const char* what) {
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/stress_hk_%d.%s", (int)getpid(), what);
+  return path;
+}
+
+/* Write the graph to a file with 4 byte entries, map it and label it. If N
+ * fits, the same is done with 2 byte entries, and no labels are returned
+ * unless both widths agree.
+ */
+static double run_graph_file(const test_graph& g, const int* occupancy,
+                             vector<int>& labels, vector<int>&) {
+  const string path = temp_path("graph");
+  double t = 0;
+  labels.clear();
+  for (int index_bytes = 4; index_bytes >= 2; index_bytes -= 2) {
+    if (index_bytes == 2 && g.N >= 0xFFFF)
+      break;
+    mapped_graph mg;
+    if (!write_graph_file(path.c_str(), g.view(), index_bytes)
+        || !map_graph_file(path.c_str(), mg)) {
+      labels.clear();
+      break;
+    }
+    vector<int> width_labels(g.N);
+    wall_clock::time_point start = wall_clock::now();
+    extended_hk_graph(&width_labels[0], mg.graph, occupancy);
+    if (index_bytes == 4) {
+      t = seconds_since(start);
+      labels.swap(width_labels);
+    }
+    else if (width_labels != labels)
+      labels.clear();
+    unmap_graph_file(mg);
+  }
+  remove(path.c_str());
+  return t;
+}
+
+/* Decoders of the label files of label_output.h. Each returns false if the
+ * file is not what it should be.
+ */
+
+static bool read_file(const string& path, vector<char>& buf) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  char block[1 << 16];
+  size_t n;
+  buf.clear();
+  while ((n = fread(block, 1, sizeof(block), f)) > 0)
+    buf.insert(buf.end(), block, block + n);
+  fclose(f);
+  return true;
+}
+
+/* Check the magic and read the number of nodes and clusters. */
+
+static bool read_label_header(const vector<char>& buf, const char* magic,
+                              long long& N, long long& n_clusters) {
+  if (buf.size() < 24 || memcmp(&buf[0], magic, 8) != 0)
+    return false;
+  memcpy(&N, &buf[8], 8);
+  memcpy(&n_clusters, &buf[16], 8);
+  return N >= 0;
+}
+
+static bool decode_fixed_width(const vector<char>& buf, vector<int>& labels) {
+  long long N, n_clusters, bits;
+  if (!read_label_header(buf, "HKLABFW1", N, n_clusters) || buf.size() < 32)
+    return false;
+  memcpy(&bits, &buf[24], 8);
+  if (bits < 1 || bits > 32
+      || (long long)buf.size() != 32 + (N * bits + 63) / 64 * 8)
+    return false;
+  const char* words = &buf[32];
+  labels.resize(N);
+  for (long long i = 0; i < N; ++i) {
+    const long long bit = i * bits;
+    unsigned long long lo, hi = 0;
+    memcpy(&lo, words + bit / 64 * 8, 8);
+    unsigned long long value = lo >> (bit % 64);
+    if (bit % 64 + bits > 64) {
+      memcpy(&hi, words + (bit / 64 + 1) * 8, 8);
+      value |= hi << (64 - bit % 64);
+    }
+    labels[i] = value & ((1ULL << bits) - 1);
+  }
+  return true;
+}
+
+static bool get_varint(const vector<char>& buf, size_t& pos,
+                       unsigned long long& v) {
+  v = 0;
+  for (int shift = 0; pos < buf.size() && shift < 64; shift += 7) {
+    const unsigned char byte = buf[pos++];
+    v |= (unsigned long long)(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+static bool decode_run_length(const vector<char>& buf, vector<int>& labels) {
+  long long N, n_clusters;
+  if (!read_label_header(buf, "HKLABRL1", N, n_clusters))
+    return false;
+  labels.clear();
+  for (size_t pos = 24; pos < buf.size(); ) {
+    unsigned long long label, length;
+    if (!get_varint(buf, pos, label) || !get_varint(buf, pos, length)
+        || labels.size() + length > (unsigned long long)N)
+      return false;
+    labels.insert(labels.end(), length, (int)label);
+  }
+  return (long long)labels.size() == N;
+}
+
+static bool decode_cluster_list(const vector<char>& buf, vector<int>& labels) {
+  long long N, n_clusters;
+  if (!read_label_header(buf, "HKLABCL1", N, n_clusters) || n_clusters < 0
+      || (long long)buf.size() < 24 + (n_clusters + 1) * 8)
+    return false;
+  vector<long long> offsets(n_clusters + 1);
+  memcpy(&offsets[0], &buf[24], offsets.size() * 8);
+  const char* members = &buf[24 + offsets.size() * 8];
+  if ((long long)buf.size() != 24 + (n_clusters + 1) * 8 + offsets.back() * 4)
+    return false;
+  labels.assign(N, 0);
+  for (long long l = 1; l <= n_clusters; ++l)
+    for (long long m = offsets[l-1]; m < offsets[l]; ++m) {
+      int node;
+      memcpy(&node, members + m * 4, 4);
+      if (node < 0 || node >= N || labels[node])
+        return false;
+      labels[node] = l;
+    }
+  return true;
+}
+
+/* Write the labels in each format of label_output.h with extended_hk_write,
+ * and on hypercubic lattices also with extended_hk_lattice_runs_write, and
+ * decode the files again. No labels are returned unless all of them agree.
+ */
+static double run_write(const test_graph& g, const int* occupancy,
+                        vector<int>& labels, vector<int>&) {
+  const string path = temp_path("labels");
+  double t = 0;
+  labels.clear();
+  bool ok = true;
+  for (int format = 0; ok && format < 3; ++format)
+    for (int labeler = 0; ok && labeler < (g.dims.empty() ? 1 : 2); ++labeler) {
+      hk_label_writer* writer;
+      if (format == 0)
+        writer = new fixed_width_writer(path.c_str());
+      else if (format == 1)
+        writer = new run_length_writer(path.c_str());
+      else
+        writer = new cluster_list_writer(path.c_str());
+
+      wall_clock::time_point start = wall_clock::now();
+      if (labeler == 0)
+        ok = extended_hk_write(g.view(), occupancy, *writer);
+      else
+        ok = extended_hk_lattice_runs_write(occupancy, &g.dims[0],
+                                            g.dims.size(), g.periodic,
+                                            *writer);
+      if (format == 0 && labeler == 0)
+        t = seconds_since(start);
+      delete writer;
+
+      vector<char> buf;
+      vector<int> decoded;
+      ok = ok && read_file(path, buf)
+           && (format == 0 ? decode_fixed_width(buf, decoded)
+               : format == 1 ? decode_run_length(buf, decoded)
+                             : decode_cluster_list(buf, decoded))
+           && (labels.empty() || decoded == labels);
+      if (ok)
+        labels.swap(decoded);
+    }
+  remove(path.c_str());
+  if (!ok)
+    labels.clear();
+  return t;
+}
+
+static const engine engines[] = {
+  {"boost", padded_table, run_boost},
+  {"no_boost", fixed_degree, run_no_boost},
+  {"graph", any_graph, run_graph},
+  {"lattice_runs", lattice, run_lattice_runs},
+  {"subdomains", any_graph, run_subdomains},
+  {"largest", any_graph, run_largest},
+  {"geometry", any_graph, run_geometry},
+  {"graph_file", any_graph, run_graph_file},
+  {"write", any_graph, run_write},
+};
+static const int n_engines = sizeof(engines) / sizeof(engines[0]);
+
+/*
+ * ---------------------------------------------------------------------------
+ * Driver
+ * ---------------------------------------------------------------------------
+ */
+
+/* Check the table itself: every bond must be listed from both ends, rows of
+ * periodic lattices must be full, and in open lattices every bond must have
+ * the same length between the lattice positions. Returns an empty string if
+ * the table is sound, otherwise what went wrong.
+ */
+static string check_graph(const test_graph& g) {
+  const int dim = g.coords.size() / max(g.N, 1);
+  vector<pair<int, int> > forward, backward;
+  double bond = -1;
+  for (int i = 0; i < g.N; ++i) {
+    long long begin = g.degree ? (long long)i * g.degree : g.offsets[i];
+    long long end = g.degree ? begin + g.degree : g.offsets[i+1];
+    for (long long j = begin; j < end; ++j) {
+      const int nb = g.nbs[j];
+      if (nb == -1) {
+        if (g.periodic && dim > 0)
+          return "padded row in a periodic lattice";
+        continue;
+      }
+      if (nb < 0 || nb >= g.N)
+        return "neighbour out of range";
+      forward.push_back(make_pair(i, nb));
+      backward.push_back(make_pair(nb, i));
+      if (dim > 0 && !g.periodic) {
+        double length = 0;
+        for (int k = 0; k < dim; ++k) {
+          const double dx = g.coords[(long long)dim*i + k]
+                            - g.coords[(long long)dim*nb + k];
+          length += dx * dx;
+        }
+        length = sqrt(length);
+        if (bond < 0)
+          bond = length;
+        if (bond == 0 || fabs(length - bond) > 1e-9 * bond)
+          return "bonds of different lengths";
+      }
+    }
+  }
+  sort(forward.begin(), forward.end());
+  sort(backward.begin(), backward.end());
+  if (forward != backward)
+    return "asymmetric neighbour table";
+  return "";
+}
+
+/* Compare labels with the reference. Returns an empty string if they agree,
+ * otherwise what went wrong.
+ */
+static string compare(const vector<int>& ref, const vector<int>& labels,
+                      const vector<int>& ref_sizes, const vector<int>& sizes) {
+  if (labels.size() != ref.size())
+    return "wrong number of labels";
+
+  // Partition equivalence: the labels must map one to one onto the reference.
+  map<int, int> forward, backward;
+  for (size_t i = 0; i < ref.size(); ++i)
+    if (forward.insert(make_pair(labels[i], ref[i])).first->second != ref[i]
+        || backward.insert(make_pair(ref[i], labels[i])).first->second != labels[i])
+      return "different partition";
+  if (labels != ref)
+    return "same partition, different canonical order";
+  if (sizes != ref_sizes)
+    return "different cluster sizes";
+  return "";
+}
+
+/* Run engine e on g, compare it with the reference and return the time. */
+
+static double check_engine(const engine& e, const test_graph& g,
+                           const vector<int>& occupancy, double p,
+                           const vector<int>& ref, const vector<int>& ref_sizes,
+                           int& failures) {
+  vector<int> labels, sizes;
+  double time = e.run(g, &occupancy[0], labels, sizes);
+  if (sizes.empty())
+    cluster_sizes(labels, sizes);
+
+  string error = compare(ref, labels, ref_sizes, sizes);
+  if (!error.empty()) {
+    failures++;
+    printf("FAIL %-16s %-13s N=%-10d p=%.4f: %s\n", g.family.c_str(),
+           e.name, g.N, p, error.c_str());
+  }
+  return time;
+}
+
+static test_graph make_graph(int family, long long target_N, MTRand& rng) {
+  const int L2 = max(2, (int)llround(sqrt((double)target_N)));
+  const int L3 = max(2, (int)llround(cbrt((double)target_N)));
+  switch (family) {
+    case 0: return hypercubic("square_periodic", 2, L2, true);
+    case 1: return hypercubic("cubic_open", 3, L3, false);
+    case 2: return random_regular(target_N, rng);
+    case 3: return scale_free(target_N, rng);
+    case 4: return permuted_square(L2, rng);
+    case 5: return zigzag_path(target_N);
+    case 6: return bravais("triangular", TRIANGULAR, 2, 1, target_N, rng);
+    case 7: return bravais("honeycomb", HONEYCOMB, 2, 2, target_N, rng);
+    case 8: return bravais("kagome", KAGOME, 2, 3, target_N, rng);
+    case 9: return bravais("bcc", BCC, 3, 1, target_N, rng);
+    case 10: return bravais("fcc", FCC, 3, 1, target_N, rng);
+    case 11: return erdos_renyi(target_N, rng);
+    case 12: return small_world(target_N, rng);
+    default: return corner_case();
+  }
+}
+static const int n_families = 14;
+
+/* The occupation probability of the timed runs: the zigzag path is timed
+ * where it is worst, everything else near the square lattice threshold.
+ */
+static double timing_p(const test_graph& g) {
+  return (g.family == "zigzag_path") ? 1.0 : 0.5927;
+}
+
+/* A graph ten times larger may take at most this many times longer per node,
+ * compared once the smaller graph has this many nodes.
+ */
+static const double max_growth = 4.0;
+static const int min_growth_N = 10000;
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    cout << "Usage: " << argv[0]
+         << " <max_N> <trials> <baseline_file> [tolerance] [update]" << endl;
+    return 2;
+  }
+  const long long max_N = atoll(argv[1]);
+  const int trials = max(1, atoi(argv[2]));
+  const string baseline_file = argv[3];
+  const double tolerance = (argc > 4) ? atof(argv[4]) : 0.2;
+  const bool update = (argc > 5) && !strcmp(argv[5], "update");
+
+  const double ps[] = {0.0, 0.3, 0.5927, 0.75, 1.0};
+  MTRand rng(12345);
+  int failures = 0;
+
+  // Best throughput (nodes per second) on the largest graph of each family.
+  map<string, double> throughput;
+
+  // Time per node on the previous size of each family, with its N.
+  map<string, pair<int, double> > per_node;
+
+  for (int family = 0; family < n_families; ++family) {
+    for (long long target_N = 100; ; target_N *= 10) {
+      target_N = min(target_N, max_N);
+      const bool largest = (target_N == max_N) || family == n_families - 1;
+
+      // Correctness over a range of p, a new graph for every trial.
+      for (int t = 0; t < trials; ++t) {
+        test_graph g = make_graph(family, target_N, rng);
+        const double p = ps[(t + family) % 5];
+        vector<int> occupancy(g.N);
+        for (int i = 0; i < g.N; ++i)
+          occupancy[i] = (rng() < p);
+
+        string error = check_graph(g);
+        if (!error.empty()) {
+          failures++;
+          printf("FAIL %-16s %-13s N=%-10d: %s\n", g.family.c_str(),
+                 "generator", g.N, error.c_str());
+        }
+
+        vector<int> ref, ref_sizes;
+        bfs_labels(g, &occupancy[0], ref);
+        cluster_sizes(ref, ref_sizes);
+        for (int e = 0; e < n_engines; ++e)
+          if (engines[e].applies(g))
+            check_engine(engines[e], g, occupancy, p, ref, ref_sizes, failures);
+      }
+
+      // Timing: the best of 'trials' runs on one input at a fixed p.
+      test_graph g = make_graph(family, target_N, rng);
+      const double p = timing_p(g);
+      vector<int> occupancy(g.N);
+      for (int i = 0; i < g.N; ++i)
+        occupancy[i] = (rng() < p);
+
+      vector<int> ref, ref_sizes;
+      bfs_labels(g, &occupancy[0], ref);
+      cluster_sizes(ref, ref_sizes);
+      for (int e = 0; e < n_engines; ++e) {
+        if (!engines[e].applies(g))
+          continue;
+        double best = HUGE_VAL;
+        for (int t = 0; t < trials; ++t)
+          best = min(best, check_engine(engines[e], g, occupancy, p, ref,
+                                        ref_sizes, failures));
+
+        // Labelling must scale linearly with the number of nodes.
+        const string key = g.family + " " + engines[e].name;
+        const double time_per_node = best / g.N;
+        map<string, pair<int, double> >::iterator prev = per_node.find(key);
+        if (prev != per_node.end() && prev->second.first >= min_growth_N
+            && time_per_node > max_growth * prev->second.second) {
+          failures++;
+          printf("SUPERLINEAR %-16s %-13s N=%-10d %.3g s/node (N=%d: %.3g)\n",
+                 g.family.c_str(), engines[e].name, g.N, time_per_node,
+                 prev->second.first, prev->second.second);
+        }
+        per_node[key] = make_pair(g.N, time_per_node);
+
+        if (largest)
+          throughput[key] = g.N / max(best, 1e-9);
+      }
+      if (largest)
+        break;
+    }
+  }
+  // Compare with the baseline, or record it.
+  ifstream in(baseline_file.c_str());
+  map<string, double> baseline;
+  string family, name;
+  long long baseline_N;
+  double rate;
+  while (in >> family >> name >> baseline_N >> rate)
+    if (baseline_N == max_N)
+      baseline[family + " " + name] = rate;
+
+  for (map<string, double>::const_iterator it = throughput.begin();
+       it != throughput.end(); ++it) {
+    map<string, double>::const_iterator base = baseline.find(it->first);
+    bool slow = !update && base != baseline.end()
+                && it->second < (1.0 - tolerance) * base->second;
+    if (slow)
+      failures++;
+    printf("%-4s %-30s %12.4g nodes/s", slow ? "SLOW" : "", it->first.c_str(),
+           it->second);
+    if (base != baseline.end())
+      printf("  (baseline %.4g)", base->second);
+    printf("\n");
+  }
+
+  if (update || baseline.empty()) {
+    ofstream out(baseline_file.c_str());
+    for (map<string, double>::const_iterator it = throughput.begin();
+         it != throughput.end(); ++it)
+      out << it->first << " " << max_N << " " << it->second << endl;
+  }
+
+  printf("%d failure(s)\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,61 @@
+/* Boundary summaries of subdomains on disk. See summary_file.h for the layout. */
+
+#include "summary_file.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+static const char summary_magic[8] = {'H','K','S','U','M','R','Y','1'};
+
+static bool write_ints(FILE* f, const vector<int>& v) {
+  return v.empty() || fwrite(&v[0], sizeof(int), v.size(), f) == v.size();
+}
+
+static bool read_ints(FILE* f, vector<int>& v, int n) {
+  v.resize(n);
+  return n == 0 || fread(&v[0], sizeof(int), n, f) == (size_t)n;
+}
+
+bool write_summary_file(const char* path, const hk_boundary_summary& summary) {
+  FILE* f = fopen(path, "wb");
+  if (!f)
+    return false;
+
+  const int header[4] = {summary.first, summary.N,
+                         (int)summary.cluster_sizes.size(),
+                         (int)summary.boundary_nodes.size()};
+  bool ok = fwrite(summary_magic, 1, sizeof(summary_magic), f)
+                == sizeof(summary_magic)
+            && fwrite(header, sizeof(int), 4, f) == 4
+            && write_ints(f, summary.cluster_sizes)
+            && write_ints(f, summary.boundary_nodes)
+            && write_ints(f, summary.boundary_labels)
+            && write_ints(f, summary.boundary_nbs);
+
+  return (fclose(f) == 0) && ok;
+}
+
+bool read_summary_file(const char* path, hk_boundary_summary& summary) {
+  FILE* f = fopen(path, "rb");
+  if (!f)
+    return false;
+
+  char magic[8];
+  int header[4];
+  bool ok = fread(magic, 1, sizeof(magic), f) == sizeof(magic)
+            && memcmp(magic, summary_magic, sizeof(magic)) == 0
+            && fread(header, sizeof(int), 4, f) == 4
+            && header[2] >= 0 && header[3] >= 0;
+  if (ok) {
+    summary.first = header[0];
+    summary.N = header[1];
+    ok = read_ints(f, summary.cluster_sizes, header[2])
+         && read_ints(f, summary.boundary_nodes, header[3])
+         && read_ints(f, summary.boundary_labels, header[3])
+         && read_ints(f, summary.boundary_nbs, header[3]);
+  }
+
+  fclose(f);
+  return ok;
+}
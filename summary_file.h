@@ -0,0 +1,20 @@
+#ifndef SUMMARY_FILE_H_
+#define SUMMARY_FILE_H_
+
+#include "hk.h"
+
+/* Boundary summaries of subdomains (see hk_label_subdomain) in a binary file,
+ * so that subdomains labelled by separate processes can be merged by another.
+ * Integers are stored in host byte order.
+ *
+ *   bytes 0-7    magic "HKSUMRY1"
+ *   then         first, N, number of clusters, number of boundary bonds
+ *   then         the cluster sizes
+ *   then         boundary_nodes, boundary_labels and boundary_nbs
+ */
+
+bool write_summary_file(const char* path, const hk_boundary_summary& summary);
+
+bool read_summary_file(const char* path, hk_boundary_summary& summary);
+
+#endif /* SUMMARY_FILE_H_ */
@@ -213,3 +213,140 @@ int main(int argc, char *argv[]) {
 //  delete [] nbs;
 //  return 0;
 //}
+
+/*
+ * ---------------------------------------------------------------------------
+ * Script for domain decomposition: each subdomain is labelled by a separate
+ * process, which passes its boundary summary to the parent through a file.
+ * ---------------------------------------------------------------------------
+ */
+
+//#include "summary_file.h"
+//#include <sys/wait.h>
+//#include <unistd.h>
+//
+//int main(int argc, char *argv[]) {
+//  int L = atoi(argv[1]);   //The length of the lattice (ex: L =1 gives 4 nodes)
+//  double p = atof(argv[2]); //The probability of populating a node.
+//  int n_domains = atoi(argv[3]); //The number of processes.
+//  const int N = L*L;
+//
+//  // Build a square lattice network with periodic lattice conditions.
+//  int* nbs = new int[4*N];
+//  for (int k = 0; k < L*L; ++k) {
+//    nbs[4*k+0] = (k/L)*L + (k%L+1)%L; //top
+//    nbs[4*k+1] = ((k/L+1)%L)*L + k%L; //right
+//    nbs[4*k+2] = (k/L)*L + (k%L+L-1)%L; //bottom
+//    nbs[4*k+3] = ((k/L+L-1)%L)*L+k%L; //left
+//  }
+//
+//  // Build the occupancies of the sites.
+//  MTRand mrand = MTRand();
+//  int* occupancy = new int[N];
+//  for (int i=0; i<N; ++i)
+//    occupancy[i] = (mrand() < p);
+//
+//  // Label each slab of rows in a child process.
+//  for (int d = 0; d < n_domains; ++d) {
+//    if (fork() == 0) {
+//      int first = (long long)N*d/n_domains;
+//      int last = (long long)N*(d+1)/n_domains;
+//      hk_graph g = {last - first, 4, 0, nbs + 4*first, 4};
+//      int* node_labels = new int[last - first];
+//      hk_boundary_summary summary;
+//      hk_label_subdomain(node_labels, g, occupancy + first, first, summary);
+//      char path[64];
+//      sprintf(path, "summary_%d.bin", d);
+//      return write_summary_file(path, summary) ? 0 : 1;
+//    }
+//  }
+//  for (int d = 0; d < n_domains; ++d)
+//    wait(NULL);
+//
+//  // Merge the summaries and compare with labelling the whole lattice.
+//  std::vector<hk_boundary_summary> summaries(n_domains);
+//  for (int d = 0; d < n_domains; ++d) {
+//    char path[64];
+//    sprintf(path, "summary_%d.bin", d);
+//    if (!read_summary_file(path, summaries[d])) {
+//      cout << "Could not read " << path << endl;
+//      return 1;
+//    }
+//  }
+//  std::vector<std::vector<int> > global_labels;
+//  std::vector<int> global_sizes;
+//  hk_merge_summaries(summaries, global_labels, global_sizes);
+//
+//  hk_graph g = {N, 4, 0, nbs, 4};
+//  int* node_labels = new int[N];
+//  extended_hk_graph(node_labels, g, occupancy);
+//  std::vector<int> sizes;
+//  for (int i = 0; i < N; ++i)
+//    if (node_labels[i]) {
+//      if (node_labels[i] > (int)sizes.size())
+//        sizes.push_back(0);
+//      sizes[node_labels[i]-1]++;
+//    }
+//
+//  cout << "Clusters: " << global_sizes.size() << " merged, "
+//       << sizes.size() << " whole" << endl;
+//  cout << (global_sizes == sizes ? "Sizes agree" : "Sizes DIFFER") << endl;
+//
+//  delete [] node_labels;
+//  delete [] occupancy;
+//  delete [] nbs;
+//  return 0;
+//}
+
+/*
+ * ---------------------------------------------------------------------------
+ * Script for an ensemble run that can be killed and resumed. Run it once,
+ * kill it (or let it finish), and run it again: it picks up from
+ * ensemble.chk and ends with the same mean as an uninterrupted run.
+ * ---------------------------------------------------------------------------
+ */
+
+//#include "generators.h"
+//#include "checkpoint.h"
+//#include "pipeline.h"
+//
+//int main(int argc, char *argv[]) {
+//  int L = atoi(argv[1]);   //The length of the lattice (ex: L =1 gives 4 nodes)
+//  double p = atof(argv[2]); //The probability of populating a node.
+//  long n_realizations = atol(argv[3]);
+//  const int dims[2] = {L, L};
+//
+//  owned_graph g;
+//  lattice_graph(g, SQUARE, dims, 2, true);
+//  const hk_graph nbs = g.view();
+//  const int N = g.N;
+//
+//  // Resume from the last checkpoint if there is one.
+//  MTRand mrand(5489UL);
+//  std::vector<MTRand*> streams(1, &mrand);
+//  std::vector<long long> counters(1, 0);  // next realization
+//  std::vector<double> observables(1, 0); // sum of the number of clusters
+//  if (read_checkpoint("ensemble.chk", streams, counters, observables))
+//    cout << "Resuming at realization " << counters[0] << endl;
+//
+//  run_pipeline(counters[0], n_realizations - counters[0], N, 3,
+//    [&](int* occupancy, long) {
+//      for (int i = 0; i < N; ++i)
+//        occupancy[i] = (mrand() < p);
+//    },
+//    [&](int* node_labels, const int* occupancy, long) {
+//      extended_hk_graph(node_labels, nbs, occupancy);
+//    },
+//    [&](const int* node_labels, const int*, long) {
+//      observables[0] += *max_element(node_labels, node_labels + N);
+//    },
+//    10, [&](long k) {
+//      counters[0] = k;
+//      write_checkpoint("ensemble.chk", streams, counters, observables);
+//    });
+//
+//  cout << "Mean number of clusters: " << observables[0] / n_realizations
+//       << endl;
+//  remove("ensemble.chk");
+//  return 0;
+//}